@@ -11,6 +11,14 @@ files {
     "%{prj.location}/src/Compiler.cpp",
     "%{prj.location}/src/Context.cpp",
     "%{prj.location}/src/ShaderBlob.cpp",
+    "%{prj.location}/src/Hash.cpp",
+    "%{prj.location}/src/Cache.cpp",
+    "%{prj.location}/src/RemoteCache.cpp",
+    "%{prj.location}/src/FileWriter.cpp",
+    "%{prj.location}/src/Compression.cpp",
+    "%{prj.location}/src/MappedFile.cpp",
+    "%{prj.location}/src/ShaderArchive.cpp",
+    "%{prj.location}/src/BlobView.cpp",
 
     "%{prj.location}/include/ShaderMake/argparse.h",
     "%{prj.location}/include/ShaderMake/Compiler.h",
@@ -18,6 +26,13 @@ files {
     "%{prj.location}/include/ShaderMake/ShaderBlob.h",
     "%{prj.location}/include/ShaderMake/ShaderMake.h",
     "%{prj.location}/include/ShaderMake/Timer.h",
+    "%{prj.location}/include/ShaderMake/Hash.h",
+    "%{prj.location}/include/ShaderMake/Cache.h",
+    "%{prj.location}/include/ShaderMake/FileWriter.h",
+    "%{prj.location}/include/ShaderMake/Compression.h",
+    "%{prj.location}/include/ShaderMake/MappedFile.h",
+    "%{prj.location}/include/ShaderMake/ShaderArchive.h",
+    "%{prj.location}/include/ShaderMake/BlobView.h",
 }
 
 includedirs {
@@ -36,7 +51,7 @@ defines {
     "_CRT_SECURE_NO_WARNINGS"
 }
 links {
-    "d3dcompiler", "dxcompiler", "delayimp"
+    "d3dcompiler", "dxcompiler", "delayimp", "ws2_32"
 }
 
 filter "system:linux"
@@ -0,0 +1,131 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "MappedFile.h"
+#include "ShaderBlob.h"
+
+#include <span>
+#include <shared_mutex>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+
+namespace ShaderMake {
+
+// Read-only view of a blob file (v1, v2, or a single shader). The file is memory mapped once and
+// permutations are returned as spans into the mapping, nothing is copied.
+// v2 blobs are validated by "Open" and searched in their table of contents. v1 blobs have no index:
+// it's built while lookups walk the blob, so it only covers the blob up to the furthest permutation
+// requested so far, and v1 entries are validated as they are walked.
+// With checksum verification enabled, the checksum of a v2 permutation is verified the first time it's looked
+// up, corrupted permutations are not found.
+// Lookups are thread safe.
+class BlobView
+{
+public:
+    BlobView() = default;
+
+    BlobView(const BlobView &) = delete;
+    BlobView &operator=(const BlobView &) = delete;
+
+    bool Open(const std::filesystem::path &file);
+    bool Open(const void *data, size_t size); // memory must outlive the view and be 8-byte aligned
+    void Close();
+
+    bool IsOpen() const { return m_Data != nullptr; }
+    uint32_t GetVersion() const { return m_Version; } // 0 = not a blob, a single shader
+    bool HasChecksums() const { return m_Checksums != nullptr; }
+    const PermutationLayout &GetPermutationLayout() const { return m_Layout; } // empty if the blob has no dimension descriptor
+
+    void SetChecksumVerification(bool isEnabled) { m_IsVerified = isEnabled; }
+
+    // Verifies the whole blob at once, see "VerifyBlob"
+    bool Verify(std::vector<std::string> *pCorrupted = nullptr) const;
+
+    // Compressed permutations are not found, they have to be read.
+    // Constants are resolved through the permutation layout, if the blob has one, no key is built.
+    bool Find(const PermutationKey &key, std::span<const uint8_t> &outBinary) const;
+    bool Find(const ShaderConstant *constants, uint32_t numConstants, std::span<const uint8_t> &outBinary) const;
+    bool FindByIndex(uint32_t index, std::span<const uint8_t> &outBinary) const; // see "Options::permutationIndex"
+
+    // Copies or decompresses a permutation
+    bool Read(const PermutationKey &key, std::vector<uint8_t> &outBinary) const;
+
+    // Compressed permutations included
+    bool Contains(const PermutationKey &key) const;
+    bool ContainsIndex(uint32_t index) const;
+
+private:
+    bool OpenData(const void *data, size_t size); // keeps "m_File"
+    const ShaderBlobTocEntry *FindEntry(const PermutationKey &key) const;
+    const ShaderBlobTocEntry *FindEntryByIndex(uint32_t index) const;
+    bool IsEntryValid(const ShaderBlobTocEntry *entry) const;
+    bool FindV1(const PermutationKey &key, std::span<const uint8_t> &outBinary) const;
+    bool FindIndexedV1(const PermutationKey &key, std::span<const uint8_t> &outBinary) const;
+
+    MappedFile m_File;
+    const uint8_t *m_Data = nullptr;
+    size_t m_Size = 0;
+    uint32_t m_Version = 0;
+
+    // v2
+    const ShaderBlobTocEntry *m_Toc = nullptr;
+    uint32_t m_EntryNum = 0;
+    const uint32_t *m_IndexTable = nullptr;
+    uint32_t m_IndexSize = 0;
+    PermutationLayout m_Layout;
+    const uint32_t *m_Checksums = nullptr;
+    std::unique_ptr<std::atomic<uint8_t>[]> m_EntryStates; // 0 = not verified yet, see "EntryState"
+    bool m_IsVerified = false;
+
+    // v1, entries before "m_ScanOffset" are indexed
+    mutable std::shared_mutex m_IndexMutex;
+    mutable std::unordered_multimap<uint64_t, uint64_t> m_Index; // key hash -> entry offset
+    mutable uint64_t m_ScanOffset = 0;
+};
+
+// Blobs searched newest first: a patch blob (see "Options::patchBaseDir") pushed on top of its base
+// overrides the permutations it holds, the rest is found in the base.
+// A permutation compressed in the layer holding it is not found by "Find", the outdated versions
+// in the layers below are never returned.
+class BlobStack
+{
+public:
+    bool Push(const std::filesystem::path &file);
+    bool Push(const void *data, size_t size); // see "BlobView::Open"
+    void Clear() { m_Layers.clear(); }
+
+    size_t GetLayerNum() const { return m_Layers.size(); }
+
+    bool Find(const PermutationKey &key, std::span<const uint8_t> &outBinary) const;
+    bool Find(const ShaderConstant *constants, uint32_t numConstants, std::span<const uint8_t> &outBinary) const;
+    bool FindByIndex(uint32_t index, std::span<const uint8_t> &outBinary) const;
+    bool Read(const PermutationKey &key, std::vector<uint8_t> &outBinary) const;
+
+private:
+    std::vector<std::unique_ptr<BlobView>> m_Layers; // base first
+};
+
+} // namespace ShaderMake
@@ -0,0 +1,217 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+
+namespace ShaderMake {
+
+// Result of an asynchronous remote cache lookup, see "RemoteCache::Lookup"
+class RemoteLookup
+{
+public:
+    // Blocks until the request is done, returns "true" on a hit
+    bool Wait(std::vector<uint8_t> &outData);
+
+private:
+    friend class RemoteCache;
+
+    std::string m_Key;
+    std::vector<uint8_t> m_Data;
+    std::mutex m_Mutex;
+    std::condition_variable m_Done;
+    bool m_IsDone = false;
+    bool m_IsHit = false;
+};
+
+// Optional remote cache tier shared between machines, speaking a minimal HTTP/1.1 protocol:
+//  GET <url>/<key> - 200 + object, or 404 on a miss
+//  PUT <url>/<key> - stores the object (skipped in read-only mode)
+// Lookups and uploads run on background threads. A transport error or timeout disables the remote
+// tier for the rest of the process, so that an unreachable server costs at most one timeout.
+class RemoteCache
+{
+public:
+    RemoteCache(const std::string &url, bool isReadOnly, uint32_t timeoutMs);
+    ~RemoteCache();
+
+    bool IsValid() const { return !m_Host.empty(); }
+    bool IsAvailable() const { return IsValid() && m_IsAvailable; }
+
+    // Starts a lookup, null if the remote tier is not available
+    std::shared_ptr<RemoteLookup> Lookup(const std::string &key);
+    bool Get(const std::string &key, std::vector<uint8_t> &outData);
+    void Put(const std::string &key, const void *data, size_t size);
+
+    // Waits until all queued uploads are finished
+    void Flush();
+
+private:
+    struct Upload
+    {
+        std::string key;
+        std::vector<uint8_t> data;
+    };
+
+    bool Request(const char *method, const std::string &key, const void *body, size_t bodySize, int &outStatus, std::vector<uint8_t> *outBody);
+    void Disable(const char *reason);
+    void LookupThread();
+    void UploadThread();
+
+    std::string m_Url;
+    std::string m_Host;
+    std::string m_Port = "80";
+    std::string m_PathPrefix;
+    uint32_t m_TimeoutMs = 0;
+    bool m_IsReadOnly = false;
+    std::atomic<bool> m_IsAvailable = true;
+
+    std::vector<std::thread> m_Lookupers;
+    std::deque<std::shared_ptr<RemoteLookup>> m_Lookups;
+    std::condition_variable m_LookupWakeUp;
+
+    std::thread m_Uploader;
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeUp;
+    std::condition_variable m_Idle;
+    std::deque<Upload> m_Uploads;
+    size_t m_PendingBytes = 0;
+    bool m_IsUploading = false;
+    bool m_Exit = false;
+};
+
+// Compile cache counters. Each compiler accumulates its own, they are merged into the persistent
+// "<directory>/stats" file once per "ProcessTasks".
+struct CacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t bytesSaved = 0; // binaries served from the cache
+    uint64_t bytesStored = 0;
+    uint64_t size = 0; // running total of the entry sizes, 0 if unknown. Not merged, owned by "CompileCache::UpdateStats"
+    std::map<std::string, uint64_t> missedShaders; // "file {entry} {defines}" -> miss count
+
+    void Merge(const CacheStats &other);
+};
+
+// Local content-addressable compile cache.
+// Entries live in "<directory>/<first 2 key chars>/<key>", the last write time of an entry is its
+// last use time, which drives LRU eviction once the total size exceeds "maxSize".
+// Every entry ends with a trailer holding the hash of the payload, which allows integrity checks.
+class CompileCache
+{
+public:
+    CompileCache(const std::filesystem::path &directory, uint64_t maxSize);
+
+    // Places a cached object at "destination" (reflinked where the file system supports it)
+    bool Fetch(const std::string &key, const std::filesystem::path &destination);
+    bool Fetch(const std::string &key, std::vector<uint8_t> &outData);
+    bool Store(const std::string &key, const void *data, size_t size);
+
+    // Deterministic compile failures are cached too, their diagnostics are replayed instead of recompiling
+    bool FetchFailure(const std::string &key, std::string &outDiagnostics);
+    bool StoreFailure(const std::string &key, const std::string &diagnostics);
+
+    // Stores are mirrored to the remote tier. Fetches are local only: a local miss starts a remote lookup with
+    // "LookupRemote" (null without a remote tier), the caller does something else meanwhile, and "FinishRemoteLookup"
+    // keeps a remote hit (success or failure, both come with one request) locally, so that the next fetch finds it.
+    void SetRemote(std::unique_ptr<RemoteCache> remote) { m_Remote = std::move(remote); }
+    RemoteCache *GetRemote() const { return m_Remote.get(); }
+    std::shared_ptr<RemoteLookup> LookupRemote(const std::string &key);
+    bool FinishRemoteLookup(const std::string &key, RemoteLookup &lookup);
+
+    // Maintenance, the work is split across "threadsNum" threads.
+    // "Collect" evicts entries unused for longer than "maxAge" seconds (0 = no limit), then least recently used ones above "maxSize".
+    // "Verify" re-hashes all entries and reports (optionally removes) corrupted ones.
+    uint32_t Collect(uint64_t maxSize, uint64_t maxAge, uint32_t threadsNum, uint64_t &outRemainingSize);
+    uint32_t Verify(uint32_t threadsNum, bool removeCorrupted, std::vector<std::filesystem::path> &outCorrupted);
+
+    bool LoadStats(CacheStats &outStats) const;
+    // Merges the counters into the stats file and adds the bytes stored since the last update to its running
+    // total size, evicting least recently used entries once it exceeds "maxSize"
+    void UpdateStats(const CacheStats &stats);
+
+    const std::filesystem::path &GetDirectory() const { return m_Directory; }
+    uint64_t GetMaxSize() const { return m_MaxSize; }
+
+private:
+    struct Entry
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type time;
+        uint64_t size;
+    };
+
+    std::vector<Entry> Scan(uint32_t threadsNum, uint64_t &outTotalSize) const;
+    uint32_t Evict(std::vector<Entry> &entries, uint64_t &totalSize, uint64_t targetSize, std::filesystem::file_time_type minTime, uint32_t threadsNum);
+    std::filesystem::path EntryPath(const std::string &key) const;
+    void Touch(const std::filesystem::path &entry);
+    void Trim(uint64_t &size);
+    void SaveStats(const CacheStats &total);
+    bool StoreLocal(const std::string &key, const void *data, size_t size);
+
+    std::filesystem::path m_Directory;
+    uint64_t m_MaxSize = 0;
+    std::atomic<uint64_t> m_StoredBytes = 0; // size change since the last "UpdateStats", removals wrap around
+    std::unique_ptr<RemoteCache> m_Remote;
+};
+
+// Size-bounded in-memory LRU map from a task identity to an immutable compiled binary.
+// Binaries are shared with the callers, so an eviction never invalidates a handed out binary.
+class MemoryCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<uint8_t>> Binary;
+
+    explicit MemoryCache(size_t maxSize) : m_MaxSize(maxSize) {}
+
+    Binary Find(const std::string &key);
+    void Insert(const std::string &key, const Binary &binary);
+
+private:
+    struct Entry
+    {
+        std::string key;
+        Binary binary;
+    };
+
+    std::list<Entry> m_Entries; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_Index;
+    size_t m_MaxSize = 0;
+    size_t m_Size = 0;
+    std::mutex m_Mutex;
+};
+
+} // namespace ShaderMake
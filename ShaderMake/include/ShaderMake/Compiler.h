@@ -25,9 +25,12 @@ THE SOFTWARE.
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <memory>
 
 #include <unordered_map>
 
+#include "Cache.h"
+
 #ifdef _WIN32
 #   include <d3dcommon.h>
 #   include <combaseapi.h>
@@ -106,8 +109,10 @@ namespace Utils {
 
     struct ShaderBlob
     {
-        std::vector<uint8_t> data;
-        size_t dataSize() const { return data.size(); }
+        std::shared_ptr<const std::vector<uint8_t>> binary; // immutable, shared with the Context's memory cache
+
+        const uint8_t *data() const { return binary ? binary->data() : nullptr; }
+        size_t dataSize() const { return binary ? binary->size() : 0; }
     };
 
     enum class CompileStatus
@@ -131,6 +136,9 @@ namespace Utils {
         void ExeCompile();
         void FxcCompile();
 
+        // Cache counters of this compiler, merged by the context once compilation is done
+        const CacheStats &GetCacheStats() const { return m_CacheStats; }
+
 #ifdef _WIN32
         std::shared_ptr<DxcInstance> DxcCompilerCreate();
         CompileStatus DxcCompile(std::shared_ptr<DxcInstance> &dxcInstance);
@@ -138,8 +146,14 @@ namespace Utils {
     private:
 #ifdef _WIN32
         void DxcCompileTask(std::shared_ptr<DxcInstance> &dxcInstance, TaskData &taskData);
+        bool DxcPreprocess(std::shared_ptr<DxcInstance> &dxcInstance, const DxcBuffer &source, const std::vector<std::wstring> &args, uint64_t &outHash);
 #endif
+        bool ExePreprocess(const TaskData &taskData, const std::string &args, uint64_t &outHash);
+        void RecordCacheMiss(const TaskData &taskData);
+        bool DeferForRemoteLookup(TaskData &taskData, const std::string &cacheKey);
+
         Context *m_Ctx = nullptr;
+        CacheStats m_CacheStats;
     };
 
 }
\ No newline at end of file
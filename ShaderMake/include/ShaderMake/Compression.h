@@ -0,0 +1,57 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace ShaderMake {
+
+// LZ77 block codec with LZ4-style sequences, tuned for fast decoding of shader binaries.
+// A dictionary acts as data preceding each block: matches may reference it, so small blocks sharing content with
+// the dictionary compress well, while each block stays independently decodable.
+// Matches reach back at most 16 Mb, larger dictionaries only contribute their tail.
+class BlockCompressor
+{
+public:
+    explicit BlockCompressor(const void *dictionary = nullptr, size_t dictionarySize = 0);
+
+    // Returns "false" if the data doesn't compress
+    bool Compress(const void *data, size_t size, std::vector<uint8_t> &outCompressed);
+
+private:
+    std::vector<uint8_t> m_Window; // dictionary + data
+    std::vector<int32_t> m_DictionaryTable; // hash table primed with the dictionary
+    std::vector<int32_t> m_Table;
+    size_t m_DictionarySize = 0;
+};
+
+bool DecompressBlock(const void *compressed, size_t compressedSize, const void *dictionary, size_t dictionarySize, void *outData, size_t size);
+
+// Builds a dictionary from the content shared by many samples (concatenated in "samples", sizes in "sampleSizes").
+// The most valuable segments are placed last, where match offsets are the shortest.
+std::vector<uint8_t> TrainDictionary(const void *samples, const std::vector<size_t> &sampleSizes, size_t maxSize);
+
+} // namespace ShaderMake
@@ -33,9 +33,15 @@ THE SOFTWARE.
 #include <iterator>
 #include <algorithm>
 #include <fstream>
+#include <memory>
 #include <stdarg.h>
 
 #include "Compiler.h"
+#include "Cache.h"
+#include "FileWriter.h"
+#include "Compression.h"
+#include "Hash.h"
+#include "ShaderBlob.h"
 
 #ifdef _WIN32
 #   include <d3dcompiler.h> // FXC
@@ -89,6 +95,13 @@ enum CompilerType : uint8_t
     CompilerType_Slang
 };
 
+enum HeaderFormat : uint8_t
+{
+    HeaderFormat_Array, // "const uint8_t name[] = {...};"
+    HeaderFormat_Embed, // C23 / C++26 "#embed" of the binary output
+    HeaderFormat_Incbin // declaration + ".S" assembly stub with ".incbin" of the binary output (GNU as, clang)
+};
+
 namespace Utils {
 static void Printf(const char *format, ...)
 {
@@ -125,6 +138,21 @@ static std::filesystem::path RemoveLeadingDotDots(const std::filesystem::path &p
 
     return result;
 }
+// Header symbols are derived from file names, which may contain characters invalid in identifiers
+static std::string ToSymbolName(const std::string &name)
+{
+    std::string symbol = name;
+    for (char &ch : symbol)
+    {
+        if (!isalnum((unsigned char)ch) && ch != '_')
+            ch = '_';
+    }
+
+    if (symbol.empty() || isdigit((unsigned char)symbol[0]))
+        symbol.insert(symbol.begin(), '_');
+
+    return symbol;
+}
 static std::string EscapePath(const std::string &s)
 {
     if (s.find(' ') != std::string::npos)
@@ -276,6 +304,9 @@ struct BlobEntry
 {
     std::string permutationFileWithoutExt;
     std::string combinedDefines;
+    std::shared_ptr<const std::vector<uint8_t>> data; // compiled code, null if spilled to "permutationFileWithoutExt"
+    std::shared_ptr<const std::vector<PermutationDimension>> dimensions; // recorded by "ExpandPermutations", shared by the permutations of a config line
+    uint32_t permutationIndex = 0; // in "dimensions"
 };
 
 class Options
@@ -314,6 +345,9 @@ public:
     bool header = false;
     bool binaryBlob = true;
     bool headerBlob = false;
+    bool headerHex = false; // header arrays as "0xAB," instead of decimal values
+    HeaderFormat headerFormat = HeaderFormat_Array;
+    uint32_t headerSplitSize = 0; // "HeaderFormat_Array" only: arrays larger than that are split into "<header>.N.c" parts, 0 = never
     bool continueOnError = false;
     bool warningsAreErrors = false;
     bool allResourcesBound = false;
@@ -329,11 +363,38 @@ public:
     bool noRegShifts = false;
     int retryCount = 10; // default 10 retries for compilation task sub-process failures
 
+    std::filesystem::path cacheDir; // compile cache directory, empty = cache disabled
+    uint64_t cacheMaxSize = 5ull << 30; // LRU eviction starts above this size (5 Gb)
+    std::string remoteCacheUrl; // optional shared cache tier "http://host:port/path", requires "cacheDir"
+    bool remoteCacheReadOnly = false;
+    uint32_t remoteCacheTimeout = 1000; // ms, the remote tier is disabled after the first timeout
+    bool cachePreprocessed = false; // key the cache by preprocessed source (DXC only), comment-only edits become hits
+    bool cacheFailures = true; // replay diagnostics of deterministic compile failures from the cache instead of recompiling
+    uint32_t blobVersion = 1; // 1 = "NVSP" (readable by older runtimes), 2 = "NVS2" with a table of contents
+    bool blobCompression = false; // v2 blobs with LZ-compressed permutations, see "ReadPermutationFromBlob"
+    bool blobDeduplication = true; // v2 blobs store byte-identical permutations once
+    uint32_t blobAlignment = 0; // v2 blobs and the archive: payload alignment (power of 2, e.g. 16, 64 or 4096 for zero-copy uploads), 0 = packed
+    bool permutationIndex = false; // v2 blobs with a dense index table, and "<blob>.permutations.h" headers computing the indices
+    bool blobChecksums = false; // v2 blobs and the archive with a CRC32C per permutation, see "VerifyBlob"
+    uint32_t blobDictionarySize = 1 << 20; // max size of the compression dictionary trained on the permutations of each blob, 0 = none
+    std::string archive; // packs all compiled shaders into this file in the output directory, see "ShaderArchive"
+    std::filesystem::path patchBaseDir; // output directory of a previous build: binary blobs and the archive become patches holding only new or changed permutations, see "BlobStack"
+    uint64_t blobMemoryMaxSize = 1ull << 30; // permutations kept in memory until their blob is written, the rest goes through intermediate files
+    bool asyncOutput = true; // outputs are written by a background writer (io_uring on Linux), compile workers don't wait for the file system
+    bool writeIfChanged = true; // outputs identical to the existing files are not rewritten, their modification times stay intact
+    size_t memoryCacheMaxSize = 64 << 20; // binaries kept in memory across "CompileShader" calls, 0 = disabled
+
     inline bool IsBlob() const
     {
         return binaryBlob || headerBlob;
     }
 
+    // Options which need the v2 blob format imply it
+    inline bool IsBlobV2() const
+    {
+        return blobVersion >= 2 || blobCompression || permutationIndex || blobAlignment > 1 || blobChecksums;
+    }
+
     void AddDefine(const std::string &define)
     {
         defines.push_back(define);
@@ -424,6 +485,7 @@ struct ConfigLine
 };
 
 class TaskData;
+class BlobView;
 
 class Context
 {
@@ -431,21 +493,51 @@ public:
     Options *options = nullptr;
     std::mutex taskMutex;
 
+    std::unique_ptr<CompileCache> cache;
+    std::mutex cacheMutex;
+    std::unique_ptr<MemoryCache> memoryCache;
+    std::unique_ptr<FileWriter> writer;
+
     std::map<std::filesystem::path, std::filesystem::file_time_type> hierarchicalUpdateTimes;
+    std::map<std::filesystem::path, uint64_t> hierarchicalContentHashes;
     std::map<std::string, std::vector<BlobEntry>> shaderBlobs;
+    std::vector<BlobEntry> archiveEntries; // "combinedDefines" holds archive keys, see "MakeArchiveKey"
+    std::shared_ptr<const std::vector<PermutationDimension>> lastPermutationDimensions; // reused by the next permutation with the same dimensions
     std::vector<TaskData> tasks;
     std::atomic<uint32_t> processedTaskCount;
     std::atomic<int> taskRetryCount;
     std::atomic<uint32_t> failedTaskCount = 0;
+    std::atomic<uint64_t> blobMemorySize = 0;
+    std::atomic<uint32_t> unchangedOutputCount = 0; // synchronous writes only, see "FileWriter::TakeUnchangedNum"
+    uint64_t blobDuplicateSize = 0; // deduplicated permutations, reported once per "ProcessTasks"
+    uint32_t blobDuplicateCount = 0;
+    uint32_t patchUnchangedCount = 0; // permutations left out of patches, see "Options::patchBaseDir"
     std::atomic<bool> terminate = false;
     uint32_t originalTaskCount;
 
-    void DumpShader(const TaskData &taskData, const uint8_t *data, size_t datSize);
-    bool ProcessConfigLine(uint32_t lineIndex, const std::string &line, const std::filesystem::file_time_type &configTime, const char *configFilepath);
-    bool ExpandPermutations(uint32_t lineIndex, const std::string &line, const std::filesystem::file_time_type &configTime, const char *configFilepath);
+    std::string compilerIdentity; // fingerprint of the compiler, see "GetCompilerIdentity"
+    int compilerChangeState = -1; // -1 = unknown, 0 = same compiler as the last build, 1 = changed
+
+    bool DumpShader(const TaskData &taskData, const uint8_t *data, size_t datSize, bool isBinaryWritten = false);
+    bool AddBlobEntryData(const TaskData &taskData, const uint8_t *data, size_t dataSize);
+    std::vector<uint8_t> TrainBlobDictionary(const std::vector<BlobEntry> &entries);
+    bool WriteHeader(const std::string &headerFile, const std::string &binaryFile, const std::string &name, const std::string &combinedDefines, const uint8_t *data, size_t dataSize);
+    void SetTaskBinary(const TaskData &taskData, const uint8_t *data, size_t dataSize);
+    bool ProcessConfigLine(uint32_t lineIndex, const std::string &line, const std::filesystem::file_time_type &configTime, const char *configFilepath, const std::vector<PermutationDimension> &expandedDimensions);
+    bool ExpandPermutations(uint32_t lineIndex, const std::string &line, const std::filesystem::file_time_type &configTime, const char *configFilepath, std::vector<PermutationDimension> &expandedDimensions);
     bool GetHierarchicalUpdateTime(const std::filesystem::path &file, std::list<std::filesystem::path> &callStack, std::filesystem::file_time_type &outTime);
+    uint64_t GetHierarchicalContentHash(const std::filesystem::path &file, std::list<std::filesystem::path> &callStack);
+    const std::string &GetCompilerIdentity();
+    bool IsCompilerChanged();
+    void UpdateCompilerStamp();
+    bool IsCacheEnabled() const { return cache && !options->pdb; } // PDBs are side outputs which are not cached
+    bool IsPreprocessedKeyEnabled() const { return IsCacheEnabled() && options->cachePreprocessed && !options->pdb && !options->embedPdb; } // debug info embeds line numbers
+    bool GetCacheKey(const TaskData &taskData, const void *args, size_t argsSize, const uint64_t *preprocessedHash, std::string &outKey);
     bool CreateBlob(const std::string &blobName, const std::vector<BlobEntry> &entries, bool useTextOutput);
     void RemoveIntermediateBlobFiles(const std::vector<BlobEntry> &entries);
+    bool CreateArchive();
+    bool OpenPatchBase(const std::string &outputFile, BlobView &outBase);
+    bool WritePermutationIndexHeader(const std::string &blobName, const std::vector<PermutationDimension> &dimensions);
 
     CompileStatus CompileShader(std::vector<std::shared_ptr<ShaderContext>> shaderContexts);
     CompileStatus CompileConfigFile(const std::string &configFilename);
@@ -462,10 +554,12 @@ private:
 class DataOutputContext
 {
 public:
-    FILE *stream = nullptr;
+    FILE *stream = nullptr; // null while the output is collected for the context's asynchronous writer
 
     DataOutputContext(Context *ctx, const char *file, bool textMode);
     ~DataOutputContext();
+    bool IsValid() const { return stream || m_IsDeferred; }
+    bool WriteText(const std::string &text);
     bool WriteDataAsText(const void *data, size_t size);
     void WriteTextPreamble(const char *shaderName, const std::string &combinedDefines);
     void WriteTextEpilog();
@@ -474,7 +568,19 @@ public:
     static bool WriteDataAsBinaryCallback(const void *data, size_t size, void *context);
 
 private:
+    bool Write(const void *data, size_t size);
+    bool FlushText();
+
     Context *m_Ctx = nullptr;
+    std::string m_File;
+    std::string m_TempFile; // large outputs are streamed into it if "writeIfChanged" is enabled
+    std::vector<uint8_t> m_Data; // deferred output
+    Hasher m_Hasher; // of the streamed data
+    bool m_IsText = false;
+    bool m_IsDeferred = false;
+    bool m_WriteIfChanged = false;
+    std::vector<char> m_TextBuffer; // formatted text, written in big chunks
+    size_t m_TextSize = 0;
     uint32_t m_lineLength = 129;
 };
 
@@ -498,6 +604,14 @@ public:
     const wchar_t *optimizationLevelRemap = nullptr;
     std::vector<std::wstring> regShifts;
     std::filesystem::path finalOutputPathNoExtension;
+    std::string memoryCacheKey; // "CompileShader" tasks only
+    std::vector<BlobEntry> *blobEntries = nullptr; // the blob this permutation belongs to, if any
+    size_t blobEntryIndex = 0;
+    std::vector<BlobEntry> *archiveEntries = nullptr; // set if the archive is enabled
+    size_t archiveEntryIndex = 0;
+    std::string cacheKey; // set while the task is deferred for a remote cache lookup
+    bool isCacheKeyPreprocessed = false; // such keys ignore line numbers, failures are not cached under them
+    std::shared_ptr<RemoteLookup> remoteLookup;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,96 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+namespace ShaderMake {
+
+struct Uring;
+
+// Synchronous write, "isText" translates line endings where the platform does
+bool WriteOutputFile(const std::string &file, const void *data, size_t size, bool isText);
+
+// Cheap equality check against an existing output: file sizes first, then content hashes.
+// "fileSize" is the size on disk, which differs from the data size for text files on Windows.
+bool IsOutputUnchanged(const std::string &file, uint64_t fileSize, uint64_t hash, bool isText);
+bool IsOutputUnchanged(const std::string &file, const void *data, size_t size, bool isText);
+
+// Asynchronous output writer: compile workers hand over complete files and continue without waiting for the file system.
+// A writer thread takes the queued files in batches. On Linux opens, writes and closes of a batch are submitted through
+// io_uring, if the kernel supports it. Elsewhere (or as a fallback) the writer thread uses buffered stdio.
+// With "writeIfChanged" files whose content is already on disk are not rewritten, keeping their modification times.
+class FileWriter
+{
+public:
+    explicit FileWriter(bool writeIfChanged);
+    ~FileWriter();
+
+    // Takes ownership of "data". Blocks only if too much data is waiting to be written.
+    void Write(const std::string &file, std::vector<uint8_t> &&data, bool isText);
+
+    // Waits until all files queued so far are written, returns the number of failed writes since the last flush
+    uint32_t Flush();
+
+    bool IsUringEnabled() const { return m_Uring != nullptr; }
+
+    // Number of files left untouched since the last call, because their content didn't change
+    uint32_t TakeUnchangedNum() { return m_UnchangedNum.exchange(0); }
+
+private:
+    struct Request
+    {
+        std::string file;
+        std::vector<uint8_t> data;
+        bool isText = false;
+        bool isFailed = false;
+    };
+
+    void WriterThread();
+    void WriteBatch(std::vector<Request> &batch);
+    void WriteBatchUring(std::vector<Request> &batch);
+
+    std::unique_ptr<Uring> m_Uring;
+
+    std::thread m_Writer;
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeUp;
+    std::condition_variable m_Progress;
+    std::deque<Request> m_Requests;
+    size_t m_PendingBytes = 0;
+    uint32_t m_FailedNum = 0;
+    std::atomic<uint32_t> m_UnchangedNum = 0;
+    bool m_WriteIfChanged = false;
+    bool m_IsWriting = false;
+    bool m_Exit = false;
+};
+
+} // namespace ShaderMake
@@ -0,0 +1,56 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace ShaderMake {
+
+// Streaming 64-bit hash (XXH64), used for content-addressed cache keys
+class Hasher
+{
+public:
+    explicit Hasher(uint64_t seed = 0);
+
+    void Update(const void *data, size_t size);
+    void Update(const std::string &s);
+    void Update(uint64_t value) { Update(&value, sizeof(value)); }
+    uint64_t Finalize() const;
+
+private:
+    uint64_t m_Acc[4];
+    uint64_t m_Seed;
+    uint64_t m_TotalSize = 0;
+    uint8_t m_Buffer[32];
+    uint32_t m_BufferSize = 0;
+};
+
+uint64_t HashData(const void *data, size_t size, uint64_t seed = 0);
+std::string HashToString(uint64_t hash);
+
+// CRC32C (Castagnoli), hardware accelerated with SSE 4.2 where available. Chainable: "Crc32c(b, n, Crc32c(a, m))".
+uint32_t Crc32c(const void *data, size_t size, uint32_t crc = 0);
+
+} // namespace ShaderMake
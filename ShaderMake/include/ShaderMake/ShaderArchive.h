@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "MappedFile.h"
+#include "ShaderBlob.h"
+
+#include <string>
+#include <string_view>
+
+namespace ShaderMake {
+
+// Shader archive: all shaders of a run packed into one v2 blob (see "Options::archive").
+// Keys are "<shader>:<permutation>", where "<shader>" is the output path relative to the output
+// directory without extension, and "<permutation>" is the permutation key (empty without defines).
+// Payloads are never compressed and shared across shaders.
+std::string MakeArchiveKey(const std::string &shaderName, const std::string &permutationKey);
+
+// Read-only view of a shader archive. The archive is validated once by "Open", lookups are binary
+// searches over the table of contents (sorted by key hash) and return pointers into the mapping, nothing is copied.
+// "Find" is const and can be called from many threads.
+class ShaderArchive
+{
+public:
+    bool Open(const std::filesystem::path &file);
+    bool Open(const void *data, size_t size); // memory must outlive the archive and be 8-byte aligned
+    void Close();
+
+    bool Find(std::string_view key, const void **pBinary, size_t *pSize) const;
+    bool Find(const PermutationKey &key, const void **pBinary, size_t *pSize) const; // no allocations, the key is "MakeArchiveKey"
+    bool Find(const char *shaderName, const ShaderConstant *constants, uint32_t numConstants, const void **pBinary, size_t *pSize) const;
+
+    uint32_t GetEntryNum() const { return m_EntryNum; }
+    std::string_view GetKey(uint32_t index) const;
+
+private:
+    bool Find(std::string_view key, uint64_t keyHash, const void **pBinary, size_t *pSize) const;
+    std::string_view GetKey(const ShaderBlobTocEntry &entry) const { return std::string_view((const char *)m_Data + entry.keyOffset, entry.keySize); }
+
+    MappedFile m_File;
+    const uint8_t *m_Data = nullptr;
+    const ShaderBlobTocEntry *m_Toc = nullptr;
+    uint32_t m_EntryNum = 0;
+};
+
+} // namespace ShaderMake
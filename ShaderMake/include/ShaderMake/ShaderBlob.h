@@ -24,10 +24,14 @@ THE SOFTWARE.
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <unordered_map>
 #include <cstdint>
 
 namespace ShaderMake {
 
+class BlockCompressor;
+
 struct ShaderConstant
 {
     const char* name;
@@ -40,6 +44,52 @@ struct ShaderBlobEntry
     uint32_t dataSize;
 };
 
+// Blob format v2: "NVS2", dictionary, payloads, keys, table of contents, dimension descriptor, index table, checksum table, footer.
+// Payloads are located through the table of contents, which allows compressed payloads.
+// The table of contents is sorted by key hash, lookups are binary searches.
+// The optional index table maps dense permutation indices to table of contents entries (0xFFFFFFFF = none),
+// see "Options::permutationIndex".
+// The optional dimension descriptor describes the index table, see "PermutationLayout". It's "uint32_t dimensionCount",
+// then for every dimension "uint32_t valueCount" followed by the define name and the values as null-terminated strings,
+// padded to 4 bytes.
+// The optional checksum table holds the CRC32C of every stored payload, in table of contents order.
+enum ShaderBlobFlags : uint32_t
+{
+    ShaderBlobFlag_Compressed = 0x1,
+};
+
+enum ShaderBlobFooterFlags : uint32_t
+{
+    ShaderBlobFooterFlag_Checksums = 0x1,
+    ShaderBlobFooterFlag_Dimensions = 0x2,
+};
+
+struct ShaderBlobTocEntry
+{
+    uint64_t keyHash; // see "HashPermutationKey"
+    uint64_t keyOffset;
+    uint64_t dataOffset;
+    uint32_t keySize;
+    uint32_t storedSize; // in the blob
+    uint32_t dataSize; // decompressed
+    uint32_t flags;
+};
+
+struct ShaderBlobFooter
+{
+    uint64_t tocOffset;
+    uint64_t dictionaryOffset;
+    uint64_t indexOffset;
+    uint32_t dictionarySize;
+    uint32_t entryCount;
+    uint32_t indexSize;
+    uint32_t flags; // see "ShaderBlobFooterFlags"
+    uint32_t version;
+    char signature[4];
+};
+
+// Returns a pointer into the blob. Payload checksums are NOT verified here (only "ReadPermutationFromBlob", "VerifyBlob"
+// and "BlobView" with "SetChecksumVerification(true)" verify them), corrupted payloads are returned as they are.
 bool FindPermutationInBlob(const void* blob, size_t blobSize, const ShaderConstant* constants, uint32_t numConstants, const void** pBinary, size_t* pSize);
 void EnumeratePermutationsInBlob( const void* blob, size_t blobSize, std::vector<std::string>& permutations);
 std::string FormatShaderNotFoundMessage(const void* blob, size_t blobSize, const ShaderConstant* constants, uint32_t numConstants);
@@ -48,4 +98,150 @@ bool WriteFileHeader(WriteFileCallback write, void* context);
 bool WritePermutation(WriteFileCallback write, void* context, const std::string& permutationKey, const void* binary, size_t binarySize);
 std::vector<size_t> GetSortedConstantsIndices(const std::vector<std::string>& constants);
 
+// Permutation key of a set of constants: "NAME=value" pairs sorted by name, separated by spaces
+std::string MakePermutationKey(const ShaderConstant* constants, uint32_t numConstants);
+uint64_t HashPermutationKey(const char* key, size_t keySize);
+
+// Canonical permutation key with its hash, built once and reused: lookups with it don't allocate
+class PermutationKey
+{
+public:
+    PermutationKey() : PermutationKey(std::string()) {}
+    PermutationKey(const ShaderConstant* constants, uint32_t numConstants) : PermutationKey(MakePermutationKey(constants, numConstants)) {}
+    explicit PermutationKey(std::string key) : m_Key(std::move(key)), m_Hash(HashPermutationKey(m_Key.data(), m_Key.size())) {}
+
+    const std::string& GetString() const { return m_Key; }
+    uint64_t GetHash() const { return m_Hash; }
+    bool IsEmpty() const { return m_Key.empty(); }
+
+private:
+    std::string m_Key;
+    uint64_t m_Hash;
+};
+
+// Same as above, payload checksums are not verified
+bool FindPermutationInBlob(const void* blob, size_t blobSize, const PermutationKey& key, const void** pBinary, size_t* pSize);
+bool ReadPermutationFromBlob(const void* blob, size_t blobSize, const PermutationKey& key, std::vector<uint8_t>& outBinary);
+
+// Finds many permutations of one blob at once, e.g. when pipelines are created at load time. The keys are sorted by hash,
+// v1 blobs are walked once for all of them and v2 lookups advance along the table of contents instead of starting over.
+// Results are positional, "pBinaries[i]" and "pSizes[i]" belong to "keys[i]" (null and 0 if not found).
+// Returns the number of permutations found. As with "FindPermutationInBlob", payload checksums are not verified.
+uint32_t FindPermutationsInBlob(const void* blob, size_t blobSize, const PermutationKey* keys, uint32_t keyNum, const void** pBinaries, size_t* pSizes);
+
+// Lookups through the index table of v2 blobs, "index" comes from a generated "<blob>.permutations.h" header
+bool FindPermutationInBlobByIndex(const void* blob, size_t blobSize, uint32_t index, const void** pBinary, size_t* pSize);
+bool ReadPermutationFromBlobByIndex(const void* blob, size_t blobSize, uint32_t index, std::vector<uint8_t>& outBinary);
+
+// A define varying across the permutations of a blob
+struct PermutationDimension
+{
+    std::string name;
+    std::vector<std::string> values;
+
+    bool operator==(const PermutationDimension& other) const = default;
+};
+
+// Dimensions of the index table of a v2 blob, in permutation key order. The index of a permutation is the sum of
+// the value indices of its defines multiplied by the strides of their dimensions (the last dimension varies the fastest).
+class PermutationLayout
+{
+public:
+    bool Load(const void* blob, size_t blobSize); // fails if the blob has no dimension descriptor
+    void Clear();
+
+    bool IsEmpty() const { return m_Dimensions.empty(); }
+    const std::vector<PermutationDimension>& GetDimensions() const { return m_Dimensions; }
+    uint32_t GetStride(uint32_t dimension) const { return m_Strides[dimension]; }
+    uint32_t GetIndexSize() const { return m_IndexSize; }
+
+    // A value index per dimension
+    uint32_t GetIndex(const uint32_t* valueIndices) const;
+
+    // ~0u if a define is missing, unknown or has an unknown value
+    uint32_t GetIndex(const ShaderConstant* constants, uint32_t numConstants) const;
+
+private:
+    std::vector<PermutationDimension> m_Dimensions;
+    std::vector<uint32_t> m_Strides;
+    uint32_t m_IndexSize = 0;
+};
+
+// 1 = "NVSP", 2 = "NVS2", 0 = not a valid blob (e.g. a single shader)
+uint32_t GetBlobVersion(const void* blob, size_t blobSize);
+
+// Validated table of contents of a v2 blob, the blob must be 8-byte aligned (as memory mapped files are)
+bool GetBlobTableOfContents(const void* blob, size_t blobSize, const ShaderBlobTocEntry** pToc, uint32_t* pEntryCount);
+const ShaderBlobTocEntry* FindInBlobTableOfContents(const void* blob, const ShaderBlobTocEntry* toc, uint32_t entryCount, const char* key, size_t keySize, uint64_t keyHash);
+
+// Checksum table of a v2 blob (in table of contents order), or null if the blob has none
+const uint32_t* GetBlobChecksums(const void* blob, size_t blobSize);
+
+// Checks the structure of a blob and the checksums of all its permutations, if it has them.
+// Keys of corrupted permutations are returned in "pCorrupted".
+bool VerifyBlob(const void* blob, size_t blobSize, std::vector<std::string>* pCorrupted = nullptr);
+
+// Copies (or decompresses) a permutation, unlike "FindPermutationInBlob" it also handles compressed v2 blobs
+// and verifies the checksum of the permutation, if the blob has them
+bool ReadPermutationFromBlob(const void* blob, size_t blobSize, const ShaderConstant* constants, uint32_t numConstants, std::vector<uint8_t>& outBinary);
+
+struct BlobWriterSettings
+{
+    bool compress = false;
+    bool deduplicate = true; // byte-identical permutations share one payload
+    std::vector<uint8_t> dictionary; // compression dictionary, see "TrainDictionary"
+    uint32_t indexSize = 0; // dense index table size, indices are passed to "AddPermutation"
+    std::vector<PermutationDimension> dimensions; // written as the descriptor of the index table, see "PermutationLayout"
+    uint32_t alignment = 0; // payload offsets are multiples of it (power of 2), 0 = packed
+    bool checksums = false; // CRC32C of every stored payload, see "VerifyBlob"
+};
+
+// Writes v2 blobs. Payloads are streamed, keys and the table of contents are written by "Finish".
+class BlobWriter
+{
+public:
+    BlobWriter(WriteFileCallback write, void* context, const BlobWriterSettings& settings);
+    ~BlobWriter();
+
+    bool AddPermutation(const std::string& permutationKey, const void* binary, size_t binarySize, uint32_t index = ~0u);
+    bool Finish();
+
+    uint64_t GetDataSize() const { return m_DataSize; } // all permutations, uncompressed
+    uint64_t GetWrittenSize() const { return m_Offset; }
+    uint32_t GetDuplicateNum() const { return m_DuplicateNum; }
+    uint64_t GetDuplicateSize() const { return m_DuplicateSize; } // uncompressed
+
+private:
+    struct Payload
+    {
+        uint64_t dataOffset;
+        uint64_t checkHash; // second hash with a different seed, guards against collisions
+        uint32_t dataSize;
+        uint32_t storedSize;
+        uint32_t flags;
+        uint32_t checksum;
+    };
+
+    bool Write(const void* data, size_t size);
+    bool WritePadding(uint32_t alignment);
+    bool Begin();
+
+    WriteFileCallback m_Write;
+    void* m_Context;
+    BlobWriterSettings m_Settings;
+    std::vector<ShaderBlobTocEntry> m_Toc;
+    std::vector<uint32_t> m_Indices; // dense indices of the entries
+    std::vector<uint32_t> m_Checksums; // of the entries
+    std::string m_Keys;
+    std::unique_ptr<BlockCompressor> m_Compressor;
+    std::vector<uint8_t> m_Compressed;
+    std::unordered_map<uint64_t, Payload> m_Payloads; // by content hash, for deduplication
+    uint64_t m_Offset = 0;
+    uint64_t m_DataSize = 0;
+    uint64_t m_DictionaryOffset = 0;
+    uint64_t m_DuplicateSize = 0;
+    uint32_t m_DuplicateNum = 0;
+    bool m_IsStarted = false;
+};
+
 } // namespace ShaderMake
\ No newline at end of file
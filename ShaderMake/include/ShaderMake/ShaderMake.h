@@ -28,3 +28,10 @@ THE SOFTWARE.
 #include "Context.h"
 #include "ShaderBlob.h"
 #include "Timer.h"
+#include "Hash.h"
+#include "Cache.h"
+#include "FileWriter.h"
+#include "Compression.h"
+#include "MappedFile.h"
+#include "ShaderArchive.h"
+#include "BlobView.h"
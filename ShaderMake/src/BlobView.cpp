@@ -0,0 +1,368 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include "BlobView.h"
+#include "Hash.h"
+
+#include <cstring>
+#include <mutex>
+
+namespace ShaderMake {
+
+enum EntryState : uint8_t
+{
+    EntryState_Unknown,
+    EntryState_Valid,
+    EntryState_Corrupted,
+};
+
+bool BlobView::Open(const std::filesystem::path &file)
+{
+    Close();
+
+    if (!m_File.Open(file))
+        return false;
+
+    if (!OpenData(m_File.GetData(), m_File.GetSize()))
+    {
+        m_File.Close();
+        return false;
+    }
+
+    return true;
+}
+
+bool BlobView::Open(const void *data, size_t size)
+{
+    // A previously opened file is not needed anymore
+    Close();
+
+    return OpenData(data, size);
+}
+
+bool BlobView::OpenData(const void *data, size_t size)
+{
+    uint32_t version = GetBlobVersion(data, size);
+
+    const ShaderBlobTocEntry *toc = nullptr;
+    uint32_t entryNum = 0;
+    ShaderBlobFooter footer = {};
+    if (version == 2)
+    {
+        if (!GetBlobTableOfContents(data, size, &toc, &entryNum))
+            return false;
+
+        memcpy(&footer, (const uint8_t *)data + size - sizeof(footer), sizeof(footer));
+    }
+
+    m_Data = (const uint8_t *)data;
+    m_Size = size;
+    m_Version = version;
+    m_Toc = toc;
+    m_EntryNum = entryNum;
+    m_IndexTable = footer.indexSize ? (const uint32_t *)(m_Data + footer.indexOffset) : nullptr;
+    m_IndexSize = footer.indexSize;
+    m_Layout.Load(data, size);
+    m_Checksums = GetBlobChecksums(data, size);
+    m_EntryStates.reset(m_Checksums ? new std::atomic<uint8_t>[entryNum]() : nullptr);
+
+    std::unique_lock<std::shared_mutex> lock(m_IndexMutex);
+    m_Index.clear();
+    m_ScanOffset = 4; // after the signature
+
+    return true;
+}
+
+void BlobView::Close()
+{
+    m_File.Close();
+
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Version = 0;
+    m_Toc = nullptr;
+    m_EntryNum = 0;
+    m_IndexTable = nullptr;
+    m_IndexSize = 0;
+    m_Layout.Clear();
+    m_Checksums = nullptr;
+    m_EntryStates.reset();
+
+    std::unique_lock<std::shared_mutex> lock(m_IndexMutex);
+    m_Index.clear();
+    m_ScanOffset = 0;
+}
+
+bool BlobView::Find(const PermutationKey &key, std::span<const uint8_t> &outBinary) const
+{
+    if (m_Version == 2)
+    {
+        const ShaderBlobTocEntry *entry = FindEntry(key);
+        if (!entry || (entry->flags & ShaderBlobFlag_Compressed) || !IsEntryValid(entry))
+            return false;
+
+        outBinary = std::span<const uint8_t>(m_Data + entry->dataOffset, entry->dataSize);
+
+        return true;
+    }
+
+    if (m_Version == 1)
+        return FindV1(key, outBinary);
+
+    // Not a permutation blob, which is fine if no permutation is requested
+    if (!m_Data || !key.IsEmpty())
+        return false;
+
+    outBinary = std::span<const uint8_t>(m_Data, m_Size);
+
+    return true;
+}
+
+bool BlobView::Find(const ShaderConstant *constants, uint32_t numConstants, std::span<const uint8_t> &outBinary) const
+{
+    if (!m_Layout.IsEmpty())
+    {
+        uint32_t index = m_Layout.GetIndex(constants, numConstants);
+
+        return index != ~0u && FindByIndex(index, outBinary);
+    }
+
+    return Find(PermutationKey(constants, numConstants), outBinary);
+}
+
+bool BlobView::FindByIndex(uint32_t index, std::span<const uint8_t> &outBinary) const
+{
+    const ShaderBlobTocEntry *entry = FindEntryByIndex(index);
+    if (!entry || (entry->flags & ShaderBlobFlag_Compressed) || !IsEntryValid(entry))
+        return false;
+
+    outBinary = std::span<const uint8_t>(m_Data + entry->dataOffset, entry->dataSize);
+
+    return true;
+}
+
+bool BlobView::Read(const PermutationKey &key, std::vector<uint8_t> &outBinary) const
+{
+    if (m_Version == 2)
+        return ReadPermutationFromBlob(m_Data, m_Size, key, outBinary);
+
+    std::span<const uint8_t> binary;
+    if (!Find(key, binary))
+        return false;
+
+    outBinary.assign(binary.begin(), binary.end());
+
+    return true;
+}
+
+bool BlobView::Contains(const PermutationKey &key) const
+{
+    if (m_Version == 2)
+        return FindEntry(key) != nullptr;
+
+    std::span<const uint8_t> binary;
+
+    return Find(key, binary);
+}
+
+bool BlobView::ContainsIndex(uint32_t index) const
+{
+    return FindEntryByIndex(index) != nullptr;
+}
+
+const ShaderBlobTocEntry *BlobView::FindEntry(const PermutationKey &key) const
+{
+    const std::string &keyString = key.GetString();
+
+    return FindInBlobTableOfContents(m_Data, m_Toc, m_EntryNum, keyString.data(), keyString.size(), key.GetHash());
+}
+
+const ShaderBlobTocEntry *BlobView::FindEntryByIndex(uint32_t index) const
+{
+    // Only v2 blobs have an index table
+    if (index >= m_IndexSize || m_IndexTable[index] >= m_EntryNum)
+        return nullptr;
+
+    return m_Toc + m_IndexTable[index];
+}
+
+bool BlobView::Verify(std::vector<std::string> *pCorrupted) const
+{
+    return m_Data && VerifyBlob(m_Data, m_Size, pCorrupted);
+}
+
+bool BlobView::IsEntryValid(const ShaderBlobTocEntry *entry) const
+{
+    if (!m_IsVerified || !m_Checksums)
+        return true;
+
+    // Threads racing on the same entry compute the same result
+    uint32_t entryIndex = (uint32_t)(entry - m_Toc);
+    uint8_t state = m_EntryStates[entryIndex].load(std::memory_order_relaxed);
+    if (state == EntryState_Unknown)
+    {
+        state = Crc32c(m_Data + entry->dataOffset, entry->storedSize) == m_Checksums[entryIndex] ? EntryState_Valid : EntryState_Corrupted;
+        m_EntryStates[entryIndex].store(state, std::memory_order_relaxed);
+    }
+
+    return state == EntryState_Valid;
+}
+
+bool BlobView::FindIndexedV1(const PermutationKey &key, std::span<const uint8_t> &outBinary) const
+{
+    const std::string &keyString = key.GetString();
+
+    auto range = m_Index.equal_range(key.GetHash());
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        ShaderBlobEntry header;
+        memcpy(&header, m_Data + it->second, sizeof(header));
+
+        const uint8_t *entryKey = m_Data + it->second + sizeof(header);
+        if (header.permutationSize == keyString.size() && memcmp(entryKey, keyString.data(), keyString.size()) == 0)
+        {
+            outBinary = std::span<const uint8_t>(entryKey + header.permutationSize, header.dataSize);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool BlobView::FindV1(const PermutationKey &key, std::span<const uint8_t> &outBinary) const
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(m_IndexMutex);
+        if (FindIndexedV1(key, outBinary))
+            return true;
+
+        if (m_ScanOffset == m_Size)
+            return false; // the whole blob is indexed
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_IndexMutex);
+
+    // Another thread could have indexed it meanwhile
+    if (FindIndexedV1(key, outBinary))
+        return true;
+
+    // Walk on, indexing the entries until the permutation is found
+    const std::string &keyString = key.GetString();
+    while (m_ScanOffset < m_Size)
+    {
+        ShaderBlobEntry header = {};
+        uint64_t remainingSize = m_Size - m_ScanOffset;
+        if (remainingSize > sizeof(header))
+            memcpy(&header, m_Data + m_ScanOffset, sizeof(header));
+
+        // The last entry is empty, a truncated entry means a corrupted blob
+        uint64_t entrySize = sizeof(header) + (uint64_t)header.permutationSize + header.dataSize;
+        if (header.dataSize == 0 || remainingSize < entrySize)
+        {
+            m_ScanOffset = m_Size;
+            break;
+        }
+
+        const uint8_t *entryKey = m_Data + m_ScanOffset + sizeof(header);
+        uint64_t entryHash = HashPermutationKey((const char *)entryKey, header.permutationSize);
+        m_Index.emplace(entryHash, m_ScanOffset);
+        m_ScanOffset += entrySize;
+
+        if (entryHash == key.GetHash() && header.permutationSize == keyString.size() && memcmp(entryKey, keyString.data(), keyString.size()) == 0)
+        {
+            outBinary = std::span<const uint8_t>(entryKey + header.permutationSize, header.dataSize);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool BlobStack::Push(const std::filesystem::path &file)
+{
+    auto view = std::make_unique<BlobView>();
+    if (!view->Open(file))
+        return false;
+
+    m_Layers.push_back(std::move(view));
+
+    return true;
+}
+
+bool BlobStack::Push(const void *data, size_t size)
+{
+    auto view = std::make_unique<BlobView>();
+    if (!view->Open(data, size))
+        return false;
+
+    m_Layers.push_back(std::move(view));
+
+    return true;
+}
+
+bool BlobStack::Find(const PermutationKey &key, std::span<const uint8_t> &outBinary) const
+{
+    for (auto layer = m_Layers.rbegin(); layer != m_Layers.rend(); ++layer)
+    {
+        if ((*layer)->Find(key, outBinary))
+            return true;
+
+        // Compressed in this layer, the layers below hold an outdated version
+        if ((*layer)->GetVersion() == 2 && (*layer)->Contains(key))
+            return false;
+    }
+
+    return false;
+}
+
+bool BlobStack::Find(const ShaderConstant *constants, uint32_t numConstants, std::span<const uint8_t> &outBinary) const
+{
+    return Find(PermutationKey(constants, numConstants), outBinary);
+}
+
+bool BlobStack::FindByIndex(uint32_t index, std::span<const uint8_t> &outBinary) const
+{
+    for (auto layer = m_Layers.rbegin(); layer != m_Layers.rend(); ++layer)
+    {
+        if ((*layer)->FindByIndex(index, outBinary))
+            return true;
+
+        if ((*layer)->ContainsIndex(index))
+            return false;
+    }
+
+    return false;
+}
+
+bool BlobStack::Read(const PermutationKey &key, std::vector<uint8_t> &outBinary) const
+{
+    for (auto layer = m_Layers.rbegin(); layer != m_Layers.rend(); ++layer)
+    {
+        if ((*layer)->Contains(key))
+            return (*layer)->Read(key, outBinary);
+    }
+
+    return false;
+}
+
+} // namespace ShaderMake
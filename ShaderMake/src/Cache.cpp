@@ -0,0 +1,613 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "Cache.h"
+#include "Context.h"
+#include "Hash.h"
+
+#include <thread>
+#include <sstream>
+#include <cstring>
+
+#ifdef __linux__
+#   include <fcntl.h>
+#   include <sys/ioctl.h>
+#   include <linux/fs.h>
+#endif
+
+namespace ShaderMake {
+
+// Leave some headroom after eviction, so that the next few stores don't trigger it again
+#define CACHE_TRIM_RATIO 0.9
+
+// Lives in the cache root, which is skipped by eviction
+#define CACHE_STATS_FILE "stats"
+
+// Only the most frequently missed shaders are kept in the stats file
+#define CACHE_STATS_MAX_MISSED_SHADERS 1024
+
+// Failure entries live next to the success entry of the same key
+#define CACHE_FAILURE_SUFFIX ".err"
+
+// Remote objects starting with it hold diagnostics of a failure, so that one request finds both kinds of entries
+#define CACHE_REMOTE_FAILURE_TAG "SMFAIL\n"
+#define CACHE_REMOTE_FAILURE_TAG_SIZE 7
+
+#define CACHE_ENTRY_SIGNATURE 0x45434D53 // "SMCE"
+
+struct CacheEntryTrailer
+{
+    uint32_t signature;
+    uint32_t reserved;
+    uint64_t hash; // of the payload
+};
+
+// Runs "func(threadIndex, itemIndex)" for all items on up to "threadsNum" threads (including the calling one)
+template<typename Func>
+static void ParallelFor(uint32_t threadsNum, size_t itemsNum, Func func)
+{
+    std::atomic<size_t> next = 0;
+    auto worker = [&](uint32_t threadIndex)
+    {
+        for (size_t i = next++; i < itemsNum; i = next++)
+            func(threadIndex, i);
+    };
+
+    threadsNum = (uint32_t)std::max<size_t>(std::min<size_t>(threadsNum, itemsNum), 1);
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < threadsNum; i++)
+        threads.emplace_back(worker, i);
+
+    worker(0);
+
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+static bool ReadTrailer(const std::filesystem::path &entry, uint64_t entrySize, CacheEntryTrailer &outTrailer)
+{
+    if (entrySize < sizeof(CacheEntryTrailer))
+        return false;
+
+    std::ifstream stream(entry, std::ios::binary);
+    stream.seekg(entrySize - sizeof(CacheEntryTrailer));
+
+    return stream.read((char *)&outTrailer, sizeof(outTrailer)) && outTrailer.signature == CACHE_ENTRY_SIGNATURE;
+}
+
+static bool ReadEntry(const std::filesystem::path &entry, std::vector<uint8_t> &outData)
+{
+    std::ifstream stream(entry, std::ios::binary | std::ios::ate);
+    if (!stream.is_open())
+        return false;
+
+    size_t size = (size_t)stream.tellg();
+    stream.seekg(0, std::ios::beg);
+
+    outData.resize(size);
+
+    return (bool)stream.read((char *)outData.data(), size);
+}
+
+// Returns the payload size, or false if the entry is truncated or corrupted
+static bool ValidateEntry(const std::vector<uint8_t> &entry, size_t &outPayloadSize)
+{
+    if (entry.size() < sizeof(CacheEntryTrailer))
+        return false;
+
+    CacheEntryTrailer trailer;
+    outPayloadSize = entry.size() - sizeof(trailer);
+    memcpy(&trailer, entry.data() + outPayloadSize, sizeof(trailer));
+
+    return trailer.signature == CACHE_ENTRY_SIGNATURE && trailer.hash == HashData(entry.data(), outPayloadSize);
+}
+
+void CacheStats::Merge(const CacheStats &other)
+{
+    hits += other.hits;
+    misses += other.misses;
+    bytesSaved += other.bytesSaved;
+    bytesStored += other.bytesStored;
+
+    for (const auto &[name, count] : other.missedShaders)
+        missedShaders[name] += count;
+}
+
+static bool CloneFile(const std::filesystem::path &source, const std::filesystem::path &destination)
+{
+#if defined(__linux__) && defined(FICLONE)
+    int src = open(source.c_str(), O_RDONLY);
+    if (src >= 0)
+    {
+        int dst = open(destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (dst >= 0)
+        {
+            bool isCloned = ioctl(dst, FICLONE, src) == 0;
+            close(dst);
+            close(src);
+
+            if (isCloned)
+                return true;
+        }
+        else
+            close(src);
+    }
+#endif
+
+    // Fall back to a regular copy if reflinks are not supported
+    std::error_code ec;
+    std::filesystem::copy_file(source, destination, std::filesystem::copy_options::overwrite_existing, ec);
+
+    return !ec;
+}
+
+CompileCache::CompileCache(const std::filesystem::path &directory, uint64_t maxSize)
+    : m_Directory(directory), m_MaxSize(maxSize)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(m_Directory, ec);
+    if (ec)
+        Utils::Printf(RED "ERROR: Can't create cache directory '%s'!\n", Utils::PathToString(m_Directory).c_str());
+}
+
+std::filesystem::path CompileCache::EntryPath(const std::string &key) const
+{
+    return m_Directory / key.substr(0, 2) / key;
+}
+
+void CompileCache::Touch(const std::filesystem::path &entry)
+{
+    // Last write time is the LRU timestamp
+    std::error_code ec;
+    std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), ec);
+}
+
+bool CompileCache::Fetch(const std::string &key, const std::filesystem::path &destination)
+{
+    std::filesystem::path entry = EntryPath(key);
+
+    std::error_code ec;
+    uint64_t entrySize = std::filesystem::file_size(entry, ec);
+    if (ec)
+        return false;
+
+    // Foreign or truncated entries are misses
+    CacheEntryTrailer trailer;
+    if (!ReadTrailer(entry, entrySize, trailer))
+        return false;
+
+    if (!CloneFile(entry, destination))
+        return false;
+
+    // Cutting the trailer off a reflinked copy doesn't touch the shared extents
+    std::filesystem::resize_file(destination, entrySize - sizeof(trailer), ec);
+    if (ec)
+        return false;
+
+    // A valid trailer doesn't mean a valid payload, a corrupted entry is dropped and becomes a miss
+    std::vector<uint8_t> payload;
+    if (!ReadEntry(destination, payload) || HashData(payload.data(), payload.size()) != trailer.hash)
+    {
+        std::filesystem::remove(destination, ec);
+        if (std::filesystem::remove(entry, ec))
+            m_StoredBytes -= entrySize;
+
+        return false;
+    }
+
+    Touch(entry);
+
+    return true;
+}
+
+bool CompileCache::Fetch(const std::string &key, std::vector<uint8_t> &outData)
+{
+    std::filesystem::path entry = EntryPath(key);
+
+    std::error_code ec;
+    if (!std::filesystem::exists(entry, ec))
+        return false;
+
+    if (!ReadEntry(entry, outData))
+        return false;
+
+    size_t payloadSize = 0;
+    if (!ValidateEntry(outData, payloadSize))
+    {
+        if (std::filesystem::remove(entry, ec))
+            m_StoredBytes -= outData.size();
+
+        return false;
+    }
+
+    outData.resize(payloadSize);
+    Touch(entry);
+
+    return true;
+}
+
+bool CompileCache::Store(const std::string &key, const void *data, size_t size)
+{
+    if (m_Remote)
+        m_Remote->Put(key, data, size);
+
+    return StoreLocal(key, data, size);
+}
+
+bool CompileCache::FetchFailure(const std::string &key, std::string &outDiagnostics)
+{
+    std::vector<uint8_t> data;
+    if (!Fetch(key + CACHE_FAILURE_SUFFIX, data))
+        return false;
+
+    outDiagnostics.assign(data.begin(), data.end());
+
+    return true;
+}
+
+bool CompileCache::StoreFailure(const std::string &key, const std::string &diagnostics)
+{
+    if (m_Remote)
+    {
+        std::string tagged = CACHE_REMOTE_FAILURE_TAG + diagnostics;
+        m_Remote->Put(key, tagged.data(), tagged.size());
+    }
+
+    return StoreLocal(key + CACHE_FAILURE_SUFFIX, diagnostics.data(), diagnostics.size());
+}
+
+std::shared_ptr<RemoteLookup> CompileCache::LookupRemote(const std::string &key)
+{
+    return m_Remote ? m_Remote->Lookup(key) : nullptr;
+}
+
+bool CompileCache::FinishRemoteLookup(const std::string &key, RemoteLookup &lookup)
+{
+    std::vector<uint8_t> data;
+    if (!lookup.Wait(data))
+        return false;
+
+    // Remote hits are kept locally, where "Fetch" and "FetchFailure" find them
+    bool isFailure = data.size() >= CACHE_REMOTE_FAILURE_TAG_SIZE && memcmp(data.data(), CACHE_REMOTE_FAILURE_TAG, CACHE_REMOTE_FAILURE_TAG_SIZE) == 0;
+    if (isFailure)
+        return StoreLocal(key + CACHE_FAILURE_SUFFIX, data.data() + CACHE_REMOTE_FAILURE_TAG_SIZE, data.size() - CACHE_REMOTE_FAILURE_TAG_SIZE);
+
+    return StoreLocal(key, data.data(), data.size());
+}
+
+bool CompileCache::StoreLocal(const std::string &key, const void *data, size_t size)
+{
+    std::filesystem::path entry = EntryPath(key);
+
+    std::error_code ec;
+    std::filesystem::create_directories(entry.parent_path(), ec);
+
+    // Write into a unique temporary file and rename it, so that concurrent ShaderMake processes never see a partial entry
+    std::stringstream tmpName;
+    tmpName << entry.filename().string() << ".tmp" << std::this_thread::get_id();
+    std::filesystem::path tmp = entry.parent_path() / tmpName.str();
+
+    FILE *stream = fopen(Utils::PathToString(tmp).c_str(), "wb");
+    if (!stream)
+        return false;
+
+    CacheEntryTrailer trailer = {};
+    trailer.signature = CACHE_ENTRY_SIGNATURE;
+    trailer.hash = HashData(data, size);
+
+    bool success = size == 0 || fwrite(data, size, 1, stream) == 1;
+    success &= fwrite(&trailer, sizeof(trailer), 1, stream) == 1;
+    success &= fclose(stream) == 0;
+
+    if (success)
+    {
+        std::filesystem::rename(tmp, entry, ec);
+        success = !ec;
+    }
+
+    if (!success)
+    {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+
+    m_StoredBytes += size + sizeof(trailer);
+
+    return true;
+}
+
+std::vector<CompileCache::Entry> CompileCache::Scan(uint32_t threadsNum, uint64_t &outTotalSize) const
+{
+    // Files directly in the root are not owned by the cache (i.e. stats), only sub-directories are scanned
+    std::vector<std::filesystem::path> subdirs;
+
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(m_Directory, ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+    {
+        if (it->is_directory(ec))
+            subdirs.push_back(it->path());
+    }
+
+    std::vector<std::vector<Entry>> threadEntries(std::max(threadsNum, 1u));
+    ParallelFor(threadsNum, subdirs.size(), [&](uint32_t threadIndex, size_t i)
+    {
+        std::error_code ec;
+        for (auto it = std::filesystem::directory_iterator(subdirs[i], ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+        {
+            if (!it->is_regular_file(ec))
+                continue;
+
+            Entry &entry = threadEntries[threadIndex].emplace_back();
+            entry.path = it->path();
+            entry.time = it->last_write_time(ec);
+            entry.size = it->file_size(ec);
+        }
+    });
+
+    std::vector<Entry> entries;
+    outTotalSize = 0;
+    for (std::vector<Entry> &threadEntry : threadEntries)
+    {
+        for (Entry &entry : threadEntry)
+        {
+            outTotalSize += entry.size;
+            entries.push_back(std::move(entry));
+        }
+    }
+
+    return entries;
+}
+
+uint32_t CompileCache::Evict(std::vector<Entry> &entries, uint64_t &totalSize, uint64_t targetSize, std::filesystem::file_time_type minTime, uint32_t threadsNum)
+{
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.time < b.time; });
+
+    // Entries are oldest first, so the evicted ones are a prefix
+    size_t evictedNum = 0;
+    uint64_t remainingSize = totalSize;
+    while (evictedNum < entries.size() && (remainingSize > targetSize || entries[evictedNum].time < minTime))
+        remainingSize -= entries[evictedNum++].size;
+
+    std::atomic<uint32_t> removedNum = 0;
+    std::atomic<uint64_t> removedSize = 0;
+    ParallelFor(threadsNum, evictedNum, [&](uint32_t, size_t i)
+    {
+        std::error_code ec;
+        if (std::filesystem::remove(entries[i].path, ec))
+        {
+            removedNum++;
+            removedSize += entries[i].size;
+        }
+    });
+
+    totalSize -= removedSize;
+    entries.erase(entries.begin(), entries.begin() + evictedNum);
+
+    return removedNum;
+}
+
+void CompileCache::Trim(uint64_t &size)
+{
+    // The running total saves a directory scan while the cache fits. It's unknown in older stats files and drifts a bit
+    // (overwritten entries, concurrent processes losing each other's updates), each scan sets it right again
+    if (size != 0 && size <= m_MaxSize)
+        return;
+
+    std::vector<Entry> entries = Scan(1, size);
+    if (size <= m_MaxSize)
+        return;
+
+    uint64_t targetSize = uint64_t(m_MaxSize * CACHE_TRIM_RATIO);
+    uint32_t evictedNum = Evict(entries, size, targetSize, std::filesystem::file_time_type::min(), 1);
+
+    Utils::Printf(WHITE "Cache: evicted %u entries, %.1f MB in use\n", evictedNum, double(size) / (1 << 20));
+}
+
+uint32_t CompileCache::Collect(uint64_t maxSize, uint64_t maxAge, uint32_t threadsNum, uint64_t &outRemainingSize)
+{
+    std::vector<Entry> entries = Scan(threadsNum, outRemainingSize);
+
+    std::filesystem::file_time_type minTime = std::filesystem::file_time_type::min();
+    if (maxAge)
+        minTime = std::filesystem::file_time_type::clock::now() - std::chrono::seconds(maxAge);
+
+    uint32_t evictedNum = Evict(entries, outRemainingSize, maxSize, minTime, threadsNum);
+
+    // Keep the running total of "UpdateStats" in sync
+    CacheStats stats;
+    LoadStats(stats);
+    stats.size = outRemainingSize;
+    SaveStats(stats);
+
+    return evictedNum;
+}
+
+uint32_t CompileCache::Verify(uint32_t threadsNum, bool removeCorrupted, std::vector<std::filesystem::path> &outCorrupted)
+{
+    uint64_t totalSize = 0;
+    std::vector<Entry> entries = Scan(threadsNum, totalSize);
+
+    std::mutex corruptedMutex;
+    ParallelFor(threadsNum, entries.size(), [&](uint32_t, size_t i)
+    {
+        std::vector<uint8_t> data;
+        size_t payloadSize = 0;
+
+        // Temporary files of interrupted stores are not entries yet
+        if (entries[i].path.filename().string().find(".tmp") != std::string::npos)
+            return;
+
+        if (ReadEntry(entries[i].path, data) && ValidateEntry(data, payloadSize))
+            return;
+
+        if (removeCorrupted)
+        {
+            std::error_code ec;
+            std::filesystem::remove(entries[i].path, ec);
+        }
+
+        std::lock_guard<std::mutex> guard(corruptedMutex);
+        outCorrupted.push_back(entries[i].path);
+    });
+
+    return (uint32_t)entries.size();
+}
+
+bool CompileCache::LoadStats(CacheStats &outStats) const
+{
+    std::ifstream stream(m_Directory / CACHE_STATS_FILE);
+    if (!stream.is_open())
+        return false;
+
+    // "<name> <value>" lines, missed shaders are "miss <count> <shader>"
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        std::istringstream lineStream(line);
+        std::string name;
+        uint64_t value = 0;
+        if (!(lineStream >> name >> value))
+            continue;
+
+        if (name == "hits")
+            outStats.hits += value;
+        else if (name == "misses")
+            outStats.misses += value;
+        else if (name == "bytesSaved")
+            outStats.bytesSaved += value;
+        else if (name == "bytesStored")
+            outStats.bytesStored += value;
+        else if (name == "size")
+            outStats.size = value;
+        else if (name == "miss")
+        {
+            std::string shader;
+            std::getline(lineStream >> std::ws, shader);
+            outStats.missedShaders[shader] += value;
+        }
+    }
+
+    return true;
+}
+
+void CompileCache::UpdateStats(const CacheStats &stats)
+{
+    uint64_t storedBytes = m_StoredBytes.exchange(0);
+    if (stats.hits == 0 && stats.misses == 0 && storedBytes == 0)
+        return;
+
+    CacheStats total;
+    LoadStats(total);
+    total.Merge(stats);
+
+    // Only stores can push the cache above "maxSize"
+    if (storedBytes)
+    {
+        if (total.size)
+            total.size += storedBytes;
+
+        Trim(total.size);
+    }
+
+    SaveStats(total);
+}
+
+void CompileCache::SaveStats(const CacheStats &total)
+{
+    std::vector<std::pair<std::string, uint64_t>> missedShaders(total.missedShaders.begin(), total.missedShaders.end());
+    std::sort(missedShaders.begin(), missedShaders.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+    if (missedShaders.size() > CACHE_STATS_MAX_MISSED_SHADERS)
+        missedShaders.resize(CACHE_STATS_MAX_MISSED_SHADERS);
+
+    std::ostringstream text;
+    text << "hits " << total.hits << "\n";
+    text << "misses " << total.misses << "\n";
+    text << "bytesSaved " << total.bytesSaved << "\n";
+    text << "bytesStored " << total.bytesStored << "\n";
+    text << "size " << total.size << "\n";
+    for (const auto &[shader, count] : missedShaders)
+        text << "miss " << count << " " << shader << "\n";
+
+    // Concurrent ShaderMake processes may lose each other's updates, but never see a partial file
+    std::stringstream tmpName;
+    tmpName << CACHE_STATS_FILE ".tmp" << std::this_thread::get_id();
+    std::filesystem::path tmp = m_Directory / tmpName.str();
+
+    std::string textString = text.str();
+    FILE *stream = fopen(Utils::PathToString(tmp).c_str(), "wb");
+    if (!stream)
+        return;
+
+    bool success = fwrite(textString.data(), textString.size(), 1, stream) == 1;
+    success &= fclose(stream) == 0;
+
+    std::error_code ec;
+    if (success)
+        std::filesystem::rename(tmp, m_Directory / CACHE_STATS_FILE, ec);
+    else
+        std::filesystem::remove(tmp, ec);
+}
+
+MemoryCache::Binary MemoryCache::Find(const std::string &key)
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    auto found = m_Index.find(key);
+    if (found == m_Index.end())
+        return nullptr;
+
+    m_Entries.splice(m_Entries.begin(), m_Entries, found->second);
+
+    return found->second->binary;
+}
+
+void MemoryCache::Insert(const std::string &key, const Binary &binary)
+{
+    // Binaries larger than the whole cache are not worth keeping
+    if (!binary || binary->size() > m_MaxSize)
+        return;
+
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    auto found = m_Index.find(key);
+    if (found != m_Index.end())
+    {
+        m_Size -= found->second->binary->size();
+        m_Entries.erase(found->second);
+        m_Index.erase(found);
+    }
+
+    m_Entries.push_front({key, binary});
+    m_Index[key] = m_Entries.begin();
+    m_Size += binary->size();
+
+    while (m_Size > m_MaxSize)
+    {
+        const Entry &last = m_Entries.back();
+        m_Size -= last.binary->size();
+        m_Index.erase(last.key);
+        m_Entries.pop_back();
+    }
+}
+
+} // namespace ShaderMake
@@ -22,6 +22,7 @@ THE SOFTWARE.
 
 #include "Compiler.h"
 #include "Context.h"
+#include "Hash.h"
 
 #include <mutex>
 #include <sstream>
@@ -109,11 +110,130 @@ namespace ShaderMake {
     };
 #endif
 
+    // Hashes preprocessor output ignoring line markers (they carry absolute paths and line numbers) and whitespace,
+    // so that edits in comments, formatting and inactive "#if" blocks produce the same hash
+    static uint64_t HashPreprocessedText(const char *text, size_t size)
+    {
+        Hasher hasher;
+        std::string line;
+
+        const char *end = text + size;
+        while (text < end)
+        {
+            const char *lineEnd = (const char *)memchr(text, '\n', end - text);
+            if (!lineEnd)
+                lineEnd = end;
+
+            // Collapse whitespace runs into a single space and trim
+            line.clear();
+            for (const char *p = text; p < lineEnd; p++)
+            {
+                if (Utils::IsSpace(*p))
+                {
+                    if (!line.empty() && line.back() != ' ')
+                        line.push_back(' ');
+                }
+                else
+                    line.push_back(*p);
+            }
+
+            if (!line.empty() && line.back() == ' ')
+                line.pop_back();
+
+            // Skip "#line N" and "# N" markers
+            bool isLineMarker = line.size() > 1 && line[0] == '#'
+                && (line.compare(1, 4, "line") == 0 || (line[1] == ' ' && line.size() > 2 && isdigit((unsigned char)line[2])));
+
+            if (!line.empty() && !isLineMarker)
+                hasher.Update(line);
+
+            if (lineEnd == end)
+                break;
+
+            text = lineEnd + 1;
+        }
+
+        return hasher.Finalize();
+    }
+
     Compiler::Compiler(Context *ctx)
         : m_Ctx(ctx)
     {
     }
 
+    void Compiler::RecordCacheMiss(const TaskData &taskData)
+    {
+        // Same naming as in the progress output
+        std::string name = taskData.filepath.generic_string() + " {" + taskData.entryPoint + "} {" + taskData.combinedDefines + "}";
+
+        m_CacheStats.misses++;
+        m_CacheStats.missedShaders[name]++;
+    }
+
+    bool Compiler::DeferForRemoteLookup(TaskData &taskData, const std::string &cacheKey)
+    {
+        // Once per task: the second pass compiles whatever the remote tier says
+        if (taskData.remoteLookup)
+            return false;
+
+        taskData.remoteLookup = m_Ctx->cache->LookupRemote(cacheKey);
+        if (!taskData.remoteLookup)
+            return false;
+
+        // Tasks are taken from the back, the lookup has the rest of the queue to finish
+        taskData.cacheKey = cacheKey;
+        {
+            std::lock_guard<std::mutex> guard(m_Ctx->taskMutex);
+            m_Ctx->tasks.insert(m_Ctx->tasks.begin(), taskData);
+        }
+
+        return true;
+    }
+
+    bool Compiler::ExePreprocess(const TaskData &taskData, const std::string &args, uint64_t &outHash)
+    {
+        // Only DXC is known to support "-P" with "-Fi"
+        if (m_Ctx->options->compilerType != CompilerType_DXC)
+            return false;
+
+        std::string preprocessedFile = taskData.finalOutputPathNoExtension.generic_string() + ".i";
+        std::string sourceFile = (m_Ctx->options->baseDirectory / taskData.filepath).generic_string();
+
+        std::ostringstream cmd;
+        cmd << m_Ctx->options->compilerPath.generic_string().c_str();
+        cmd << " -nologo -P -Fi " << Utils::EscapePath(preprocessedFile);
+        cmd << args;
+        cmd << " " << Utils::EscapePath(sourceFile);
+        cmd << " 2>&1";
+
+        if (m_Ctx->options->verbose)
+            Utils::Printf(WHITE "%s\n", cmd.str().c_str());
+
+        FILE *pipe = popen(cmd.str().c_str(), "r");
+        if (!pipe)
+            return false;
+
+        // Diagnostics are reported by the real compilation
+        char buf[1024];
+        while (fgets(buf, sizeof(buf), pipe))
+            ;
+
+        bool isSucceeded = pclose(pipe) == 0;
+        if (isSucceeded)
+        {
+            std::ifstream stream(preprocessedFile, std::ios::binary);
+            std::string text((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+            isSucceeded = !text.empty();
+            outHash = HashPreprocessedText(text.data(), text.size());
+        }
+
+        std::error_code ec;
+        std::filesystem::remove(preprocessedFile, ec);
+
+        return isSucceeded;
+    }
+
 #ifdef _WIN32
     void Compiler::FxcCompile()
     {
@@ -173,6 +293,10 @@ namespace ShaderMake {
 
             bool isSucceeded = SUCCEEDED(hr) && codeBlob;
 
+            std::string diagnostics;
+            if (errorBlob && errorBlob->GetBufferSize())
+                diagnostics.assign((const char *)errorBlob->GetBufferPointer(), strnlen((const char *)errorBlob->GetBufferPointer(), errorBlob->GetBufferSize()));
+
             if (m_Ctx->terminate)
                 break;
 
@@ -224,7 +348,7 @@ namespace ShaderMake {
             }
 
             // Update progress
-            taskData.UpdateProgress(m_Ctx, isSucceeded, false, errorBlob ? (char *)errorBlob->GetBufferPointer() : nullptr);
+            taskData.UpdateProgress(m_Ctx, isSucceeded, false, diagnostics.empty() ? nullptr : diagnostics.c_str());
 
             // Terminate if this shader failed and "--continue" is not set
             if (m_Ctx->terminate)
@@ -339,6 +463,31 @@ namespace ShaderMake {
         return CompileStatus::Success;
     }
 
+    bool Compiler::DxcPreprocess(std::shared_ptr<DxcInstance> &dxcInstance, const DxcBuffer &source, const std::vector<std::wstring> &args, uint64_t &outHash)
+    {
+        std::vector<const wchar_t *> argPointers;
+        argPointers.reserve(args.size() + 1);
+        for (const std::wstring &arg : args)
+            argPointers.push_back(arg.c_str());
+        argPointers.push_back(L"-P");
+
+        ComPtr<IDxcIncludeHandler> pDefaultIncludeHandler;
+        dxcInstance->utils->CreateDefaultIncludeHandler(&pDefaultIncludeHandler);
+
+        ComPtr<IDxcResult> dxcResult;
+        HRESULT hr = dxcInstance->compiler->Compile(&source, argPointers.data(), (uint32_t)argPointers.size(), pDefaultIncludeHandler.Get(), IID_PPV_ARGS(&dxcResult));
+        if (SUCCEEDED(hr))
+            dxcResult->GetStatus(&hr);
+
+        ComPtr<IDxcBlobUtf8> preprocessed;
+        if (FAILED(hr) || FAILED(dxcResult->GetOutput(DXC_OUT_HLSL, IID_PPV_ARGS(&preprocessed), nullptr)) || !preprocessed)
+            return false;
+
+        outHash = HashPreprocessedText(preprocessed->GetStringPointer(), preprocessed->GetStringLength());
+
+        return true;
+    }
+
     void Compiler::DxcCompileTask(std::shared_ptr<DxcInstance> &dxcInstance, TaskData &taskData)
     {
         // Compiling the shader
@@ -349,12 +498,18 @@ namespace ShaderMake {
         ComPtr<IDxcBlobEncoding> errorBlob;
         bool isSucceeded = false;
 
+        std::vector<std::wstring> args;
+        std::string cacheKey;
+        std::string diagnostics;
+        std::vector<uint8_t> cachedBinary;
+        bool isCached = false;
+        bool isFailureCached = false;
+
         ComPtr<IDxcBlobEncoding> sourceBlob;
         HRESULT hr = dxcInstance->utils->LoadFile(wsourceFile.c_str(), nullptr, &sourceBlob);
 
         if (SUCCEEDED(hr))
         {
-            std::vector<std::wstring> args;
             args.reserve(16 + (m_Ctx->options->defines.size()
                 + taskData.defines.size()
                 + m_Ctx->options->includeDirs.size()) * 2
@@ -462,6 +617,71 @@ namespace ShaderMake {
                 Utils::Printf(WHITE "%ls\n", cmd.str().c_str());
             }
 
+            // Look up the compile cache, the key skips the source file path (the first argument)
+            std::wstring keyArgs;
+            for (size_t i = 1; i < args.size(); i++)
+            {
+                keyArgs += L" ";
+                keyArgs += args[i];
+            }
+
+            bool hasCacheKey = false;
+            if (taskData.remoteLookup)
+            {
+                // Back from the remote lookup: the key is known, keep what the remote tier has
+                cacheKey = taskData.cacheKey;
+                m_Ctx->cache->FinishRemoteLookup(cacheKey, *taskData.remoteLookup);
+                hasCacheKey = true;
+            }
+            else
+            {
+                uint64_t preprocessedHash = 0;
+                bool isPreprocessed = false;
+                if (m_Ctx->IsPreprocessedKeyEnabled())
+                {
+                    DxcBuffer sourceBuffer = {};
+                    sourceBuffer.Ptr = sourceBlob->GetBufferPointer();
+                    sourceBuffer.Size = sourceBlob->GetBufferSize();
+
+                    isPreprocessed = DxcPreprocess(dxcInstance, sourceBuffer, args, preprocessedHash);
+                }
+
+                taskData.isCacheKeyPreprocessed = isPreprocessed;
+
+                hasCacheKey = m_Ctx->GetCacheKey(taskData, keyArgs.data(), keyArgs.size() * sizeof(wchar_t), isPreprocessed ? &preprocessedHash : nullptr, cacheKey);
+            }
+
+            // Diagnostics carry line numbers, which a preprocessed key doesn't cover
+            bool isFailureCacheable = m_Ctx->options->cacheFailures && !taskData.isCacheKeyPreprocessed;
+
+            if (hasCacheKey)
+            {
+                isCached = m_Ctx->cache->Fetch(cacheKey, cachedBinary);
+                isFailureCached = !isCached && isFailureCacheable && m_Ctx->cache->FetchFailure(cacheKey, diagnostics);
+
+                if (!isCached && !isFailureCached)
+                {
+                    if (DeferForRemoteLookup(taskData, cacheKey))
+                        return;
+
+                    RecordCacheMiss(taskData);
+                }
+            }
+
+            if (isCached || isFailureCached)
+            {
+                if (m_Ctx->options->verbose)
+                    Utils::Printf(WHITE "Cache hit%s %s: %s\n", isFailureCached ? " (failure)" : "", cacheKey.c_str(), taskData.filepath.generic_string().c_str());
+
+                if (isFailureCached)
+                    m_CacheStats.hits++;
+
+                isSucceeded = isCached;
+            }
+        }
+
+        if (SUCCEEDED(hr) && !isCached && !isFailureCached)
+        {
             // Now that args are finalized, get their C-string pointers into a vector
             std::vector<const wchar_t *> argPointers;
             argPointers.reserve(args.size());
@@ -490,6 +710,13 @@ namespace ShaderMake {
 
             isSucceeded = SUCCEEDED(hr) && codeBlob;
 
+            if (errorBlob && errorBlob->GetBufferSize())
+                diagnostics.assign((const char *)errorBlob->GetBufferPointer(), strnlen((const char *)errorBlob->GetBufferPointer(), errorBlob->GetBufferSize()));
+
+            // The compiler ran and rejected the input: a deterministic failure
+            if (!isSucceeded && dxcResult && !cacheKey.empty() && m_Ctx->options->cacheFailures && !taskData.isCacheKeyPreprocessed)
+                m_Ctx->cache->StoreFailure(cacheKey, diagnostics);
+
             // Dump PDB
             if (isSucceeded && m_Ctx->options->pdb)
             {
@@ -516,23 +743,24 @@ namespace ShaderMake {
         // Dump output
         if (isSucceeded)
         {
-            std::filesystem::path filenameWithoutTargetExtension = (m_Ctx->options->baseDirectory / m_Ctx->options->outputDir / taskData.filepath.filename());
-            taskData.finalOutputPathNoExtension = filenameWithoutTargetExtension.replace_extension(m_Ctx->options->outputExt);
+            const uint8_t *bufferPtr = isCached ? cachedBinary.data() : (const uint8_t *)codeBlob->GetBufferPointer();
+            size_t bufferSize = isCached ? cachedBinary.size() : codeBlob->GetBufferSize();
 
-            if (taskData.blob)
+            if (isCached)
             {
-                size_t bufferSize = codeBlob->GetBufferSize();
-                const void* bufferPtr = codeBlob->GetBufferPointer();
-
-                taskData.blob->data.resize(bufferSize);
-                std::memcpy(taskData.blob->data.data(), bufferPtr, bufferSize);
+                m_CacheStats.hits++;
+                m_CacheStats.bytesSaved += bufferSize;
             }
+            else if (!cacheKey.empty() && m_Ctx->cache->Store(cacheKey, bufferPtr, bufferSize))
+                m_CacheStats.bytesStored += bufferSize;
+
+            m_Ctx->SetTaskBinary(taskData, bufferPtr, bufferSize);
 
-            m_Ctx->DumpShader(taskData, (uint8_t *)codeBlob->GetBufferPointer(), codeBlob->GetBufferSize());
+            m_Ctx->DumpShader(taskData, bufferPtr, bufferSize);
         }
 
         // Update progress
-        taskData.UpdateProgress(m_Ctx, isSucceeded, false, errorBlob ? (char *)errorBlob->GetBufferPointer() : nullptr);
+        taskData.UpdateProgress(m_Ctx, isSucceeded, false, diagnostics.empty() ? nullptr : diagnostics.c_str());
     }
 #endif
 
@@ -559,23 +787,21 @@ namespace ShaderMake {
                 m_Ctx->tasks.pop_back();
             }
 
-            bool convertBinaryOutputToHeader = false;
-
-            std::filesystem::path filepathCopy = taskData.filepath; 
-            std::string compiledName = filepathCopy.replace_extension("").generic_string() + m_Ctx->options->outputExt;
-            std::string outputFile = (m_Ctx->options->baseDirectory / (m_Ctx->options->outputDir + "/" + compiledName)).generic_string();
+            // Headers are produced from the binary output by "DumpShader", the same way as on the API path.
+            // With "writeIfChanged" the binary is compiled next to the output, "DumpShader" replaces the output only if it differs.
+            std::string outputFile = taskData.finalOutputPathNoExtension.generic_string() + m_Ctx->options->outputExt;
+            std::string compiledFile = m_Ctx->options->writeIfChanged ? outputFile + ".tmp" : outputFile;
 
-            // Building command line
+            // Building command line: "args" holds everything affecting the compiled code, "cmd" adds output and source paths
+            std::ostringstream args;
             std::ostringstream cmd;
             {
                 cmd << m_Ctx->options->compilerPath.generic_string().c_str(); // call the compiler
 
                 if (m_Ctx->options->compilerType == CompilerType_Slang)
                 {
-                    if (m_Ctx->options->header || (m_Ctx->options->headerBlob && taskData.combinedDefines.empty()))
-                    {
-                        convertBinaryOutputToHeader = true;
-                    }
+                    // Output
+                    cmd << " -o " << Utils::EscapePath(compiledFile);
 
                     // Slang defaults to slang language mode unless -lang <other language> sets something else.
                     // For HLSL compatibility mode:
@@ -584,93 +810,84 @@ namespace ShaderMake {
                     if (m_Ctx->options->slangHlsl)
                     {
                         // Language mode: hlsl
-                        cmd << " -lang hlsl";
+                        args << " -lang hlsl";
 
                         // Treat enums as unscoped
-                        cmd << " -unscoped-enum";
+                        args << " -unscoped-enum";
                     }
 
                     // Profile
-                    cmd << " -profile " << taskData.profile << "_" << taskData.shaderModel;
+                    args << " -profile " << taskData.profile << "_" << taskData.shaderModel;
 
                     // Target/platform
-                    cmd << " -target " << Utils::PlatformToString(m_Ctx->options->platformType);
-
-                    // Output
-                    cmd << " -o " << Utils::EscapePath(outputFile);
+                    args << " -target " << Utils::PlatformToString(m_Ctx->options->platformType);
 
                     // Entry point
                     if (taskData.profile != "lib")
                     {
                         // Don't specify entry if profile is lib_*, Slang will use the entry point currently
-                        cmd << " -entry " << taskData.entryPoint;
+                        args << " -entry " << taskData.entryPoint;
                     }
 
                     // Defines
                     for (const std::string &define : taskData.defines)
-                        cmd << " -D " << define;
+                        args << " -D " << define;
 
                     for (const std::string &define : m_Ctx->options->defines)
-                        cmd << " -D " << define;
+                        args << " -D " << define;
 
                     // Include directories
                     for (const std::filesystem::path &dir : m_Ctx->options->includeDirs)
-                        cmd << " -I " << Utils::EscapePath(dir.string());
+                        args << " -I " << Utils::EscapePath(dir.string());
 
                     // Optimization level
-                    cmd << " -O" << taskData.optimizationLevel;
+                    args << " -O" << taskData.optimizationLevel;
 
                     // Warnings as errors
                     if (m_Ctx->options->warningsAreErrors)
-                        cmd << " -warnings-as-errors";
+                        args << " -warnings-as-errors";
 
                     // Matrix layout
                     if (m_Ctx->options->matrixRowMajor)
-                        cmd << " -matrix-layout-row-major";
+                        args << " -matrix-layout-row-major";
                     else
-                        cmd << " -matrix-layout-column-major";
+                        args << " -matrix-layout-column-major";
 
                     if (m_Ctx->options->platformType == PlatformType_SPIRV)
                     {
                         // Uses the entrypoint name from the source instead of 'main' in the SPIRV output
-                        cmd << " -fvk-use-entrypoint-name";
+                        args << " -fvk-use-entrypoint-name";
 
                         if (!m_Ctx->options->vulkanMemoryLayout.empty())
                         {
                             if (strcmp(m_Ctx->options->vulkanMemoryLayout.c_str(), "scalar") == 0)
-                                cmd << " -force-glsl-scalar-layout";
+                                args << " -force-glsl-scalar-layout";
                             else if (strcmp(m_Ctx->options->vulkanMemoryLayout.c_str(), "gl") == 0)
-                                cmd << " -fvk-use-gl-layout";
+                                args << " -fvk-use-gl-layout";
                         }
 
                         if (!m_Ctx->options->noRegShifts)
                         {
                             for (uint32_t space = 0; space < SPIRV_SPACES_NUM; space++)
                             {
-                                cmd << " -fvk-t-shift " << m_Ctx->options->tRegShift << " " << space;
-                                cmd << " -fvk-s-shift " << m_Ctx->options->sRegShift << " " << space;
-                                cmd << " -fvk-b-shift " << m_Ctx->options->bRegShift << " " << space;
-                                cmd << " -fvk-u-shift " << m_Ctx->options->uRegShift << " " << space;
+                                args << " -fvk-t-shift " << m_Ctx->options->tRegShift << " " << space;
+                                args << " -fvk-s-shift " << m_Ctx->options->sRegShift << " " << space;
+                                args << " -fvk-b-shift " << m_Ctx->options->bRegShift << " " << space;
+                                args << " -fvk-u-shift " << m_Ctx->options->uRegShift << " " << space;
                             }
                         }
                     }
 
                     // Custom options
                     for (std::string const &opts : m_Ctx->options->compilerOptions)
-                        cmd << " " << opts;
+                        args << " " << opts;
                 }
                 else
                 {
                     cmd << " -nologo";
 
                     // Output file
-                    if (m_Ctx->options->binary || m_Ctx->options->binaryBlob || (m_Ctx->options->headerBlob && !taskData.combinedDefines.empty()))
-                        cmd << " -Fo " << Utils::EscapePath(outputFile);
-                    if (m_Ctx->options->header || (m_Ctx->options->headerBlob && taskData.combinedDefines.empty()))
-                    {
-                        cmd << " -Fh " << Utils::EscapePath(outputFile) << ".h";
-                        cmd << " -Vn " << taskData.filepath.filename().generic_string();
-                    }
+                    cmd << " -Fo " << Utils::EscapePath(compiledFile);
 
                     // Profile
                     std::string profile = taskData.profile + "_";
@@ -678,74 +895,74 @@ namespace ShaderMake {
                         profile += "5_0";
                     else
                         profile += taskData.shaderModel;
-                    cmd << " -T " << profile;
+                    args << " -T " << profile;
 
                     // Entry point
-                    cmd << " -E " << taskData.entryPoint;
+                    args << " -E " << taskData.entryPoint;
 
                     // Defines
                     for (const std::string &define : taskData.defines)
-                        cmd << " -D " << define;
+                        args << " -D " << define;
 
                     for (const std::string &define : m_Ctx->options->defines)
-                        cmd << " -D " << define;
+                        args << " -D " << define;
 
                     // Include directories
                     for (const std::filesystem::path &dir : m_Ctx->options->includeDirs)
-                        cmd << " -I " << Utils::EscapePath(dir.string());
+                        args << " -I " << Utils::EscapePath(dir.string());
 
                     // Args
-                    cmd << optimizationLevelRemap[taskData.optimizationLevel];
+                    args << optimizationLevelRemap[taskData.optimizationLevel];
 
                     uint32_t shaderModelIndex = (taskData.shaderModel[0] - '0') * 10 + (taskData.shaderModel[2] - '0');
                     if (m_Ctx->options->platformType != PlatformType_DXBC && shaderModelIndex >= 62)
-                        cmd << " -enable-16bit-types";
+                        args << " -enable-16bit-types";
 
                     if (m_Ctx->options->warningsAreErrors)
-                        cmd << " -WX";
+                        args << " -WX";
 
                     if (m_Ctx->options->allResourcesBound)
-                        cmd << " -all_resources_bound";
+                        args << " -all_resources_bound";
 
                     if (m_Ctx->options->matrixRowMajor)
-                        cmd << " -Zpr";
+                        args << " -Zpr";
 
                     if (m_Ctx->options->hlsl2021)
-                        cmd << " -HV 2021";
+                        args << " -HV 2021";
 
                     if (m_Ctx->options->pdb || m_Ctx->options->embedPdb)
-                        cmd << " -Zi -Zsb"; // only binary affects hash
+                        args << " -Zi -Zsb"; // only binary affects hash
 
                     if (m_Ctx->options->embedPdb)
-                        cmd << " -Qembed_debug";
+                        args << " -Qembed_debug";
 
                     if (m_Ctx->options->platformType == PlatformType_SPIRV)
                     {
-                        cmd << " -spirv";
+                        args << " -spirv";
 
-                        cmd << " -fspv-target-env=vulkan" << m_Ctx->options->vulkanVersion;
+                        args << " -fspv-target-env=vulkan" << m_Ctx->options->vulkanVersion;
 
                         if (!m_Ctx->options->vulkanMemoryLayout.empty())
-                            cmd << " -fvk-use-" << m_Ctx->options->vulkanMemoryLayout << "-layout";
+                            args << " -fvk-use-" << m_Ctx->options->vulkanMemoryLayout << "-layout";
 
                         for (const std::string &ext : m_Ctx->options->spirvExtensions)
-                            cmd << " -fspv-extension=" << ext;
+                            args << " -fspv-extension=" << ext;
 
                         if (!m_Ctx->options->noRegShifts)
                         {
                             for (uint32_t space = 0; space < SPIRV_SPACES_NUM; space++)
                             {
-                                cmd << " -fvk-t-shift " << m_Ctx->options->tRegShift << " " << space;
-                                cmd << " -fvk-s-shift " << m_Ctx->options->sRegShift << " " << space;
-                                cmd << " -fvk-b-shift " << m_Ctx->options->bRegShift << " " << space;
-                                cmd << " -fvk-u-shift " << m_Ctx->options->uRegShift << " " << space;
+                                args << " -fvk-t-shift " << m_Ctx->options->tRegShift << " " << space;
+                                args << " -fvk-s-shift " << m_Ctx->options->sRegShift << " " << space;
+                                args << " -fvk-b-shift " << m_Ctx->options->bRegShift << " " << space;
+                                args << " -fvk-u-shift " << m_Ctx->options->uRegShift << " " << space;
                             }
                         }
                     }
                     else // Not supported by SPIRV gen
                     {
                         if (m_Ctx->options->stripReflection)
-                            cmd << " -Qstrip_reflect";
+                            args << " -Qstrip_reflect";
 
                         if (m_Ctx->options->pdb)
                         {
@@ -756,9 +973,11 @@ namespace ShaderMake {
 
                     // Custom options
                     for (std::string const &opts : m_Ctx->options->compilerOptions)
-                        cmd << " " << opts;
+                        args << " " << opts;
                 }
 
+                cmd << args.str();
+
                 // Source file
                 std::string sourceFile = (m_Ctx->options->baseDirectory / taskData.filepath).generic_string();
                 cmd << " " << Utils::EscapePath(sourceFile);
@@ -766,77 +985,138 @@ namespace ShaderMake {
 
             cmd << " 2>&1";
 
-            // Debug output
-            if (m_Ctx->options->verbose)
-                Utils::Printf(WHITE "%s\n", cmd.str().c_str());
+            // Look up the compile cache
+            std::string argsString = args.str();
+            std::string cacheKey;
+            std::string cachedDiagnostics;
+            bool isCached = false;
+            bool isFailureCached = false;
 
-            // Compiling the shader
-            std::ostringstream msg;
-            FILE *pipe = popen(cmd.str().c_str(), "r");
+            bool hasCacheKey = false;
+            if (taskData.remoteLookup)
+            {
+                // Back from the remote lookup: the key is known, keep what the remote tier has
+                cacheKey = taskData.cacheKey;
+                m_Ctx->cache->FinishRemoteLookup(cacheKey, *taskData.remoteLookup);
+                hasCacheKey = true;
+            }
+            else
+            {
+                uint64_t preprocessedHash = 0;
+                bool isPreprocessed = m_Ctx->IsPreprocessedKeyEnabled() && ExePreprocess(taskData, argsString, preprocessedHash);
+                taskData.isCacheKeyPreprocessed = isPreprocessed;
+
+                hasCacheKey = m_Ctx->GetCacheKey(taskData, argsString.data(), argsString.size(), isPreprocessed ? &preprocessedHash : nullptr, cacheKey);
+            }
 
-            bool isSucceeded = false, willRetry = false;
-            if (pipe)
+            // Diagnostics carry line numbers, which a preprocessed key doesn't cover
+            bool isFailureCacheable = m_Ctx->options->cacheFailures && !taskData.isCacheKeyPreprocessed;
+
+            if (hasCacheKey)
             {
-                char buf[1024];
-                while (fgets(buf, sizeof(buf), pipe))
+                isCached = m_Ctx->cache->Fetch(cacheKey, compiledFile);
+                isFailureCached = !isCached && isFailureCacheable && m_Ctx->cache->FetchFailure(cacheKey, cachedDiagnostics);
+
+                if (!isCached && !isFailureCached)
                 {
-                    // Ignore useless unmutable FXC message
-                    if (strstr(buf, "compilation object save succeeded"))
+                    if (DeferForRemoteLookup(taskData, cacheKey))
                         continue;
 
-                    msg << buf;
+                    RecordCacheMiss(taskData);
                 }
+                else if (m_Ctx->options->verbose)
+                    Utils::Printf(WHITE "Cache hit%s %s: %s\n", isFailureCached ? " (failure)" : "", cacheKey.c_str(), outputFile.c_str());
+            }
+
+            // Compiling the shader
+            std::ostringstream msg;
+            bool isSucceeded = isCached, willRetry = false;
+
+            if (isFailureCached)
+            {
+                m_CacheStats.hits++;
+                msg << cachedDiagnostics;
+            }
+            else if (!isCached)
+            {
+                // Debug output
+                if (m_Ctx->options->verbose)
+                    Utils::Printf(WHITE "%s\n", cmd.str().c_str());
+
+                FILE *pipe = popen(cmd.str().c_str(), "r");
+                if (pipe)
+                {
+                    char buf[1024];
+                    while (fgets(buf, sizeof(buf), pipe))
+                    {
+                        // Ignore useless unmutable FXC message
+                        if (strstr(buf, "compilation object save succeeded"))
+                            continue;
+
+                        msg << buf;
+                    }
 
-                const int result = pclose(pipe);
-                // Check status, see https://pubs.opengroup.org/onlinepubs/009696699/functions/pclose.html
-                const bool childProcessError = (result == -1 && errno == ECHILD);
+                    const int result = pclose(pipe);
+                    // Check status, see https://pubs.opengroup.org/onlinepubs/009696699/functions/pclose.html
+                    const bool childProcessError = (result == -1 && errno == ECHILD);
 #ifdef WIN32
-                const bool commandShellError = false;
+                    const bool commandShellError = false;
 #else
-                const bool commandShellError = (WIFEXITED(result) && WEXITSTATUS(result) == 127);
+                    const bool commandShellError = (WIFEXITED(result) && WEXITSTATUS(result) == 127);
 #endif
 
-                if (result == 0)
-                    isSucceeded = true;
+                    if (result == 0)
+                        isSucceeded = true;
 
-                // Retry if count > 0 and failed to execute child sub-process or command shell (posix only)
-                else if (m_Ctx->taskRetryCount > 0 && (childProcessError || commandShellError))
-                    willRetry = true;
+                    // Retry if count > 0 and failed to execute child sub-process or command shell (posix only)
+                    else if (m_Ctx->taskRetryCount > 0 && (childProcessError || commandShellError))
+                        willRetry = true;
+
+                    // Only a regular non-zero exit code is a deterministic failure, crashes and shell errors are not cached
+#ifdef WIN32
+                    const bool isCompileError = result > 0;
+#else
+                    const bool isCompileError = WIFEXITED(result) && WEXITSTATUS(result) != 0 && !commandShellError;
+#endif
+
+                    if (isCompileError && !cacheKey.empty() && isFailureCacheable)
+                        m_Ctx->cache->StoreFailure(cacheKey, msg.str());
+                }
             }
 
-            // Slang cannot produce .h files directly, so we convert its binary output to .h here if needed
-            if (isSucceeded && convertBinaryOutputToHeader)
+            // Read the compiled binary back: it's needed for the cache, headers and the caller's blob
+            if (isSucceeded)
             {
                 std::vector<uint8_t> buffer;
-                if (Utils::ReadBinaryFile(outputFile.c_str(), buffer))
+                if (Utils::ReadBinaryFile(compiledFile.c_str(), buffer))
                 {
-                    std::string headerFile = taskData.filepath.filename().generic_string() + m_Ctx->options->outputExt + ".h";
-                    DataOutputContext context(m_Ctx, headerFile.c_str(), true);
-                    if (context.stream)
+                    if (isCached)
                     {
-                        std::string shaderName = taskData.filepath.filename().generic_string();
-                        context.WriteTextPreamble(shaderName.c_str(), taskData.combinedDefines);
-                        context.WriteDataAsText(buffer.data(), buffer.size());
-                        context.WriteTextEpilog();
-
-                        // Delete the binary file if it's not requested
-                        if (!m_Ctx->options->binary)
-                            std::filesystem::remove(outputFile);
-                    }
-                    else
-                    {
-                        Utils::Printf(RED "ERROR: Failed to open file '%s' for writing!\n", headerFile.c_str());
-                        isSucceeded = false;
+                        m_CacheStats.hits++;
+                        m_CacheStats.bytesSaved += buffer.size();
                     }
+                    else if (!cacheKey.empty() && m_Ctx->cache->Store(cacheKey, buffer.data(), buffer.size()))
+                        m_CacheStats.bytesStored += buffer.size();
+
+                    m_Ctx->SetTaskBinary(taskData, buffer.data(), buffer.size());
+
+                    // Delete the binary file if it's not needed
+                    bool isWrittenInPlace = compiledFile == outputFile;
+                    if (!m_Ctx->DumpShader(taskData, buffer.data(), buffer.size(), isWrittenInPlace) && isWrittenInPlace)
+                        std::filesystem::remove(outputFile);
                 }
                 else
-                {
                     isSucceeded = false;
-                }
+            }
+
+            if (compiledFile != outputFile)
+            {
+                std::error_code ec;
+                std::filesystem::remove(compiledFile, ec);
             }
 
             // Update progress
-            taskData.UpdateProgress(m_Ctx, isSucceeded, willRetry, msg.str().c_str());
+            taskData.UpdateProgress(m_Ctx, isSucceeded, willRetry, isCached ? nullptr : msg.str().c_str());
         }
     }
 }
@@ -0,0 +1,426 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include "Compression.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _MSC_VER
+#   include <intrin.h>
+#endif
+
+namespace ShaderMake {
+
+// Sequence format: token (literal length : 4, match length - LZ_MIN_MATCH : 4), extra literal length bytes, literals,
+// 24-bit offset, extra match length bytes. A length nibble of 15 continues in extra bytes, each 255 adds and continues.
+// The last sequence has literals only.
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET ((1 << 24) - 1)
+#define LZ_HASH_BITS 16
+
+// Dictionary training: d-mer size, segment size and the size of the hashed d-mer tables
+#define DICTIONARY_DMER_SIZE 8
+#define DICTIONARY_SEGMENT_SIZE 256
+#define DICTIONARY_HASH_BITS 20
+
+static inline uint32_t Read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t Read64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t CountTrailingZeros(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctzll(v);
+#endif
+}
+
+static inline uint32_t HashSequence(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Number of equal bytes at "p" and "match" ("match" precedes "p"), not crossing "end"
+static inline size_t CountMatch(const uint8_t *p, const uint8_t *match, const uint8_t *end)
+{
+    const uint8_t *begin = p;
+    while (p + 8 <= end)
+    {
+        uint64_t diff = Read64(p) ^ Read64(match);
+        if (diff)
+            return (p - begin) + CountTrailingZeros(diff) / 8;
+
+        p += 8;
+        match += 8;
+    }
+
+    while (p < end && *p == *match)
+    {
+        p++;
+        match++;
+    }
+
+    return p - begin;
+}
+
+static void WriteLength(std::vector<uint8_t> &out, size_t length)
+{
+    while (length >= 255)
+    {
+        out.push_back(255);
+        length -= 255;
+    }
+
+    out.push_back((uint8_t)length);
+}
+
+static void WriteSequence(std::vector<uint8_t> &out, const uint8_t *literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+    size_t matchCode = matchLength ? matchLength - LZ_MIN_MATCH : 0;
+    out.push_back((uint8_t)(std::min<size_t>(literalLength, 15) << 4 | std::min<size_t>(matchCode, 15)));
+
+    if (literalLength >= 15)
+        WriteLength(out, literalLength - 15);
+
+    out.insert(out.end(), literals, literals + literalLength);
+
+    // The last sequence has no match
+    if (matchLength)
+    {
+        out.push_back((uint8_t)(offset & 0xFF));
+        out.push_back((uint8_t)((offset >> 8) & 0xFF));
+        out.push_back((uint8_t)(offset >> 16));
+
+        if (matchCode >= 15)
+            WriteLength(out, matchCode - 15);
+    }
+}
+
+static inline bool ReadLength(const uint8_t *&p, const uint8_t *end, size_t &length)
+{
+    uint8_t value;
+    do
+    {
+        if (p == end)
+            return false;
+
+        value = *p++;
+        length += value;
+    } while (value == 255);
+
+    return true;
+}
+
+BlockCompressor::BlockCompressor(const void *dictionary, size_t dictionarySize)
+{
+    // Only the tail of the dictionary is reachable
+    if (dictionarySize > LZ_MAX_OFFSET)
+    {
+        dictionary = (const uint8_t *)dictionary + dictionarySize - LZ_MAX_OFFSET;
+        dictionarySize = LZ_MAX_OFFSET;
+    }
+
+    m_DictionarySize = dictionarySize;
+    m_Window.assign((const uint8_t *)dictionary, (const uint8_t *)dictionary + dictionarySize);
+
+    m_DictionaryTable.assign(1 << LZ_HASH_BITS, -1);
+    for (size_t i = 0; i + LZ_MIN_MATCH <= dictionarySize; i++)
+        m_DictionaryTable[HashSequence(Read32(m_Window.data() + i))] = (int32_t)i;
+}
+
+bool BlockCompressor::Compress(const void *data, size_t size, std::vector<uint8_t> &outCompressed)
+{
+    outCompressed.clear();
+    outCompressed.reserve(size / 2);
+
+    // Matches are searched in "dictionary + data"
+    m_Window.resize(m_DictionarySize);
+    m_Window.insert(m_Window.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+    m_Table = m_DictionaryTable;
+
+    const uint8_t *base = m_Window.data();
+    const uint8_t *end = base + m_Window.size();
+    const uint8_t *p = base + m_DictionarySize;
+    const uint8_t *anchor = p;
+
+    uint32_t missNum = 0;
+    while (p + LZ_MIN_MATCH <= end)
+    {
+        uint32_t sequence = Read32(p);
+        uint32_t hash = HashSequence(sequence);
+        int32_t candidate = m_Table[hash];
+        m_Table[hash] = (int32_t)(p - base);
+
+        if (candidate < 0 || (p - base) - candidate > LZ_MAX_OFFSET || Read32(base + candidate) != sequence)
+        {
+            // Skip faster through incompressible data
+            p += 1 + (missNum++ >> 6);
+            continue;
+        }
+
+        missNum = 0;
+
+        // Extend backwards over pending literals, then forwards
+        const uint8_t *match = base + candidate;
+        while (p > anchor && match > base && p[-1] == match[-1])
+        {
+            p--;
+            match--;
+        }
+
+        size_t matchLength = CountMatch(p, match, end);
+        WriteSequence(outCompressed, anchor, p - anchor, p - match, matchLength);
+
+        p += matchLength;
+        anchor = p;
+
+        if (p + LZ_MIN_MATCH - 2 <= end)
+            m_Table[HashSequence(Read32(p - 2))] = (int32_t)(p - 2 - base);
+    }
+
+    WriteSequence(outCompressed, anchor, end - anchor, 0, 0);
+
+    return outCompressed.size() < size;
+}
+
+bool DecompressBlock(const void *compressed, size_t compressedSize, const void *dictionary, size_t dictionarySize, void *outData, size_t size)
+{
+    if (dictionarySize > LZ_MAX_OFFSET)
+    {
+        dictionary = (const uint8_t *)dictionary + dictionarySize - LZ_MAX_OFFSET;
+        dictionarySize = LZ_MAX_OFFSET;
+    }
+
+    const uint8_t *ip = (const uint8_t *)compressed;
+    const uint8_t *ipEnd = ip + compressedSize;
+    const uint8_t *dictionaryEnd = (const uint8_t *)dictionary + dictionarySize;
+    uint8_t *dst = (uint8_t *)outData;
+    uint8_t *op = dst;
+    uint8_t *opEnd = dst + size;
+
+    while (ip < ipEnd)
+    {
+        uint32_t token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !ReadLength(ip, ipEnd, literalLength))
+            return false;
+
+        if (literalLength > (size_t)(ipEnd - ip) || literalLength > (size_t)(opEnd - op))
+            return false;
+
+        // Short literals are copied with a fixed size, if there is room for it
+        if (literalLength <= 16 && ipEnd - ip >= 16 && opEnd - op >= 16)
+            memcpy(op, ip, 16);
+        else
+            memcpy(op, ip, literalLength);
+
+        op += literalLength;
+        ip += literalLength;
+
+        // The last sequence has literals only
+        if (ip == ipEnd)
+            break;
+
+        if (ipEnd - ip < 3)
+            return false;
+
+        size_t offset = ip[0] | (ip[1] << 8) | (ip[2] << 16);
+        ip += 3;
+
+        size_t matchLength = (token & 15) + LZ_MIN_MATCH;
+        if ((token & 15) == 15 && !ReadLength(ip, ipEnd, matchLength))
+            return false;
+
+        if (offset == 0 || matchLength > (size_t)(opEnd - op))
+            return false;
+
+        // A match reaching before the block starts in the dictionary
+        size_t producedSize = op - dst;
+        if (offset > producedSize)
+        {
+            size_t dictionaryOffset = offset - producedSize;
+            if (dictionaryOffset > dictionarySize)
+                return false;
+
+            size_t length = std::min(dictionaryOffset, matchLength);
+            memcpy(op, dictionaryEnd - dictionaryOffset, length);
+            op += length;
+            matchLength -= length;
+        }
+
+        const uint8_t *match = op - offset;
+        if (offset >= 16 && (size_t)(opEnd - op) >= matchLength + 16)
+        {
+            // Copies in 16-byte chunks, which may write past the match, but not past the output
+            for (size_t i = 0; i < matchLength; i += 16)
+                memcpy(op + i, match + i, 16);
+
+            op += matchLength;
+        }
+        else if (offset >= matchLength)
+        {
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        }
+        else
+        {
+            // Overlapping copy, repeats the last "offset" bytes
+            for (; offset >= 8 && matchLength >= 8; matchLength -= 8, op += 8, match += 8)
+                memcpy(op, match, 8);
+
+            for (; matchLength; matchLength--)
+                *op++ = *match++;
+        }
+    }
+
+    return op == opEnd;
+}
+
+std::vector<uint8_t> TrainDictionary(const void *samples, const std::vector<size_t> &sampleSizes, size_t maxSize)
+{
+    const uint8_t *data = (const uint8_t *)samples;
+
+    size_t totalSize = 0;
+    for (size_t sampleSize : sampleSizes)
+        totalSize += sampleSize;
+
+    std::vector<uint8_t> dictionary;
+    if (totalSize < DICTIONARY_SEGMENT_SIZE || maxSize < DICTIONARY_SEGMENT_SIZE)
+        return dictionary;
+
+    const size_t tableSize = 1 << DICTIONARY_HASH_BITS;
+    auto HashDmer = [](const uint8_t *p) { return (uint32_t)((Read64(p) * 0x9E3779B185EBCA87ull) >> (64 - DICTIONARY_HASH_BITS)); };
+
+    // Number of samples containing each d-mer, hash collisions are tolerated
+    std::vector<uint32_t> frequencies(tableSize, 0);
+    {
+        std::vector<uint32_t> lastSample(tableSize, UINT32_MAX);
+
+        size_t offset = 0;
+        for (uint32_t i = 0; i < (uint32_t)sampleSizes.size(); i++)
+        {
+            for (size_t j = 0; j + DICTIONARY_DMER_SIZE <= sampleSizes[i]; j++)
+            {
+                uint32_t hash = HashDmer(data + offset + j);
+                if (lastSample[hash] != i)
+                {
+                    lastSample[hash] = i;
+                    frequencies[hash]++;
+                }
+            }
+
+            offset += sampleSizes[i];
+        }
+    }
+
+    // Content of a single sample is not worth a place in the dictionary
+    for (uint32_t &frequency : frequencies)
+    {
+        if (frequency < 2)
+            frequency = 0;
+    }
+
+    // The data is split into epochs, the segment covering the most frequent d-mers of each epoch goes into the dictionary
+    size_t segmentNum = std::min(maxSize, totalSize) / DICTIONARY_SEGMENT_SIZE;
+    size_t epochSize = totalSize / segmentNum;
+
+    struct Segment
+    {
+        size_t offset;
+        uint64_t score;
+    };
+
+    std::vector<Segment> segments;
+    std::vector<uint16_t> windowCounts(tableSize, 0);
+
+    for (size_t epoch = 0; epoch < segmentNum; epoch++)
+    {
+        size_t begin = epoch * epochSize;
+        size_t end = std::min(begin + epochSize + DICTIONARY_SEGMENT_SIZE, totalSize);
+
+        // Sliding window, each distinct d-mer counts once
+        uint64_t score = 0;
+        Segment best = {begin, 0};
+        size_t windowBegin = begin;
+        size_t p = begin;
+        for (; p + DICTIONARY_DMER_SIZE <= end; p++)
+        {
+            uint32_t hash = HashDmer(data + p);
+            if (windowCounts[hash]++ == 0)
+                score += frequencies[hash];
+
+            if (p + DICTIONARY_DMER_SIZE - windowBegin > DICTIONARY_SEGMENT_SIZE)
+            {
+                uint32_t removed = HashDmer(data + windowBegin);
+                if (--windowCounts[removed] == 0)
+                    score -= frequencies[removed];
+
+                windowBegin++;
+            }
+
+            if (score > best.score)
+                best = {windowBegin, score};
+        }
+
+        for (; windowBegin < p; windowBegin++)
+            windowCounts[HashDmer(data + windowBegin)] = 0;
+
+        if (!best.score)
+            continue;
+
+        // Covered d-mers don't add value to other segments
+        size_t bestEnd = std::min(best.offset + DICTIONARY_SEGMENT_SIZE, totalSize);
+        for (size_t i = best.offset; i + DICTIONARY_DMER_SIZE <= bestEnd; i++)
+            frequencies[HashDmer(data + i)] = 0;
+
+        segments.push_back(best);
+    }
+
+    // The most valuable segments go last, closest to the compressed data
+    std::stable_sort(segments.begin(), segments.end(), [](const Segment &a, const Segment &b) { return a.score < b.score; });
+
+    for (const Segment &segment : segments)
+    {
+        size_t segmentEnd = std::min(segment.offset + DICTIONARY_SEGMENT_SIZE, totalSize);
+        dictionary.insert(dictionary.end(), data + segment.offset, data + segmentEnd);
+    }
+
+    return dictionary;
+}
+
+} // namespace ShaderMake
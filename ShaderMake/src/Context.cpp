@@ -23,6 +23,9 @@ THE SOFTWARE.
 #include "Context.h"
 #include "argparse.h"
 #include "ShaderBlob.h"
+#include "ShaderArchive.h"
+#include "BlobView.h"
+#include "Hash.h"
 
 #ifdef _WIN32
 #   include <windows.h>
@@ -30,6 +33,8 @@ THE SOFTWARE.
 #endif
 #include <list>
 #include <regex>
+#include <sstream>
+#include <optional>
 #include <cassert>
 
 namespace ShaderMake {
@@ -313,6 +318,34 @@ Context::Context(Options *opts)
     : options(opts)
 {
     ProcessOptions();
+
+    // PDBs are written by the compiler as side outputs, a cache hit would skip them
+    if (options && options->pdb && !options->cacheDir.empty())
+        Utils::Printf(YELLOW "WARNING: PDB files are not cached, the compile cache is disabled\n");
+    else if (options && !options->cacheDir.empty())
+    {
+        cache = std::make_unique<CompileCache>(options->cacheDir, options->cacheMaxSize);
+
+        if (!options->remoteCacheUrl.empty())
+        {
+            std::unique_ptr<RemoteCache> remote = std::make_unique<RemoteCache>(options->remoteCacheUrl, options->remoteCacheReadOnly, options->remoteCacheTimeout);
+            if (remote->IsValid())
+                cache->SetRemote(std::move(remote));
+        }
+    }
+    else if (options && !options->remoteCacheUrl.empty())
+        Utils::Printf(YELLOW "WARNING: Remote cache requires a local cache directory, ignoring '%s'\n", options->remoteCacheUrl.c_str());
+
+    if (options && options->memoryCacheMaxSize)
+        memoryCache = std::make_unique<MemoryCache>(options->memoryCacheMaxSize);
+
+    if (options && options->asyncOutput)
+    {
+        writer = std::make_unique<FileWriter>(options->writeIfChanged);
+
+        if (options->verbose)
+            Utils::Printf(WHITE "Output writer: %s\n", writer->IsUringEnabled() ? "io_uring" : "writer thread");
+    }
 }
 
 
@@ -395,16 +428,265 @@ bool Context::GetHierarchicalUpdateTime(const std::filesystem::path &file, std::
     return true;
 }
 
-void Context::DumpShader(const TaskData &taskData, const uint8_t *data, size_t dataSize)
+uint64_t Context::GetHierarchicalContentHash(const std::filesystem::path &file, std::list<std::filesystem::path> &callStack)
+{
+    static const std::basic_regex<char> includePattern("\\s*#include\\s+[\"<]([^>\"]+)[>\"].*");
+
+    auto found = hierarchicalContentHashes.find(file);
+    if (found != hierarchicalContentHashes.end())
+        return found->second;
+
+    Hasher hasher;
+
+    std::ifstream stream(file, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    hasher.Update(content);
+
+    callStack.push_front(file);
+
+    // Unlike update times, relaxed includes are not skipped here: a cached object must match its inputs exactly
+    std::filesystem::path path = file.parent_path();
+    std::istringstream lines(content);
+    for (std::string line; std::getline(lines, line);)
+    {
+        std::match_results<const char *> matchResult;
+        std::regex_match(line.c_str(), matchResult, includePattern);
+        if (matchResult.empty())
+            continue;
+
+        std::filesystem::path includeName = std::string(matchResult[1]);
+
+        bool isFound = false;
+        std::filesystem::path includeFile = path / includeName;
+        if (std::filesystem::exists(includeFile))
+            isFound = true;
+        else
+        {
+            for (const std::filesystem::path &includePath : options->includeDirs)
+            {
+                includeFile = includePath / includeName;
+                if (std::filesystem::exists(includeFile))
+                {
+                    isFound = true;
+                    break;
+                }
+            }
+        }
+
+        // Missing includes can be in inactive "#if" blocks, the compiler will complain otherwise
+        hasher.Update(includeName.generic_string());
+        if (!isFound || std::find(callStack.begin(), callStack.end(), includeFile) != callStack.end())
+            continue;
+
+        hasher.Update(GetHierarchicalContentHash(includeFile, callStack));
+    }
+
+    callStack.pop_front();
+
+    uint64_t hash = hasher.Finalize();
+    hierarchicalContentHashes[file] = hash;
+
+    return hash;
+}
+
+// Output directory file remembering the identity of the compiler which produced the outputs
+#define COMPILER_STAMP_FILE ".shadermake_compiler"
+
+static std::filesystem::path ResolveExecutablePath(const std::filesystem::path &path)
+{
+    if (path.has_parent_path() || std::filesystem::exists(path))
+        return path;
+
+    // Search in PATH, like the shell does
+    const char *env = std::getenv("PATH");
+    if (!env)
+        return path;
+
+#ifdef _WIN32
+    const char separator = ';';
+    const char *extensions[] = { "", ".exe" };
+#else
+    const char separator = ':';
+    const char *extensions[] = { "" };
+#endif
+
+    std::string dirs = env;
+    size_t start = 0;
+    while (start <= dirs.size())
+    {
+        size_t end = dirs.find(separator, start);
+        if (end == std::string::npos)
+            end = dirs.size();
+
+        for (const char *extension : extensions)
+        {
+            std::filesystem::path candidate = std::filesystem::path(dirs.substr(start, end - start)) / path;
+            candidate += extension;
+
+            std::error_code ec;
+            if (end > start && std::filesystem::is_regular_file(candidate, ec))
+                return candidate;
+        }
+
+        start = end + 1;
+    }
+
+    return path;
+}
+
+const std::string &Context::GetCompilerIdentity()
+{
+    struct Fingerprint
+    {
+        uintmax_t size = 0;
+        std::filesystem::file_time_type time;
+        std::string identity;
+    };
+
+    // Shared by all contexts: the executable is hashed and "--version" is run only once per path,
+    // or again if the size or the time stamp has changed since. The identity itself depends on
+    // contents only, so that re-installing the same compiler doesn't invalidate anything
+    static std::map<std::filesystem::path, Fingerprint> fingerprints;
+    static std::mutex fingerprintsMutex;
+
+    std::lock_guard<std::mutex> guard(cacheMutex);
+    if (!compilerIdentity.empty())
+        return compilerIdentity;
+
+    std::filesystem::path path = ResolveExecutablePath(options->compilerPath);
+
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(path, ec);
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(path, ec);
+
+    std::lock_guard<std::mutex> fingerprintsGuard(fingerprintsMutex);
+    Fingerprint &fingerprint = fingerprints[path];
+    if (fingerprint.identity.empty() || fingerprint.size != size || fingerprint.time != time)
+    {
+        Hasher hasher;
+        hasher.Update((uint64_t)size);
+        hasher.Update((uint64_t)options->compilerType);
+
+        // Executable contents
+        std::ifstream stream(path, std::ios::binary);
+        std::vector<char> buf(1 << 20);
+        while (stream.read(buf.data(), buf.size()) || stream.gcount())
+            hasher.Update(buf.data(), (size_t)stream.gcount());
+
+        // Version reported by the compiler, DXC also reports the version of its compiler library here
+        const char *versionArg = options->compilerType == CompilerType_DXC ? "--version" : (options->compilerType == CompilerType_Slang ? "-v" : nullptr);
+        if (versionArg && size)
+        {
+            std::string cmd = Utils::EscapePath(path.generic_string()) + " " + versionArg + " 2>&1";
+            if (FILE *pipe = popen(cmd.c_str(), "r"))
+            {
+                char line[1024];
+                while (fgets(line, sizeof(line), pipe))
+                    hasher.Update(line, strlen(line));
+                pclose(pipe);
+            }
+        }
+
+        fingerprint.size = size;
+        fingerprint.time = time;
+        fingerprint.identity = HashToString(hasher.Finalize());
+
+        if (options->verbose)
+            Utils::Printf(WHITE "Compiler '%s' identity: %s\n", Utils::PathToString(path).c_str(), fingerprint.identity.c_str());
+    }
+
+    compilerIdentity = fingerprint.identity;
+
+    return compilerIdentity;
+}
+
+bool Context::IsCompilerChanged()
+{
+    if (compilerChangeState < 0)
+    {
+        std::filesystem::path stampFile = options->baseDirectory / options->outputDir / COMPILER_STAMP_FILE;
+
+        std::ifstream stream(stampFile);
+        std::string previousIdentity;
+        std::getline(stream, previousIdentity);
+
+        compilerChangeState = previousIdentity == GetCompilerIdentity() ? 0 : 1;
+
+        if (compilerChangeState && !previousIdentity.empty())
+            Utils::Printf(YELLOW "Compiler has changed since the last build, all shaders will be recompiled\n");
+    }
+
+    return compilerChangeState != 0;
+}
+
+void Context::UpdateCompilerStamp()
+{
+    if (compilerChangeState != 1)
+        return;
+
+    std::filesystem::path outputDir = options->baseDirectory / options->outputDir;
+
+    std::error_code ec;
+    std::filesystem::create_directories(outputDir, ec);
+
+    std::ofstream stream(outputDir / COMPILER_STAMP_FILE);
+    stream << GetCompilerIdentity() << std::endl;
+
+    if (stream)
+        compilerChangeState = 0;
+}
+
+bool Context::GetCacheKey(const TaskData &taskData, const void *args, size_t argsSize, const uint64_t *preprocessedHash, std::string &outKey)
+{
+    if (!IsCacheEnabled())
+        return false;
+
+    Hasher hasher;
+
+    // Compiler identity
+    hasher.Update(GetCompilerIdentity());
+    hasher.Update((uint64_t)options->platformType);
+
+    // Full argument vector, except output and source paths
+    hasher.Update(argsSize);
+    hasher.Update(args, argsSize);
+
+    // Preprocessed source, or the source and all transitive includes
+    hasher.Update((uint64_t)(preprocessedHash ? 1 : 0));
+    if (preprocessedHash)
+        hasher.Update(*preprocessedHash);
+    else
+    {
+        std::lock_guard<std::mutex> guard(cacheMutex);
+
+        std::list<std::filesystem::path> callStack;
+        hasher.Update(GetHierarchicalContentHash(options->baseDirectory / taskData.filepath, callStack));
+    }
+
+    outKey = HashToString(hasher.Finalize());
+
+    return true;
+}
+
+// Returns "true" if the binary output file is needed, i.e. requested by the user or spilled for blob assembly
+bool Context::DumpShader(const TaskData &taskData, const uint8_t *data, size_t dataSize, bool isBinaryWritten)
 {
-    std::string finalOutputFilepath = taskData.finalOutputPathNoExtension.generic_string();
+    std::string finalOutputFilepath = taskData.finalOutputPathNoExtension.generic_string() + options->outputExt;
+
+    // A single permutation without defines is its own blob, see "ProcessTasks"
+    bool isSpilled = !AddBlobEntryData(taskData, data, dataSize);
+    bool isHeaderNeeded = options->header || (options->headerBlob && taskData.combinedDefines.empty());
+    bool isBinaryNeeded = options->binary || (options->binaryBlob && taskData.combinedDefines.empty()) || isSpilled;
+
+    // "#embed" and ".incbin" headers reference the binary
+    isBinaryNeeded |= isHeaderNeeded && options->headerFormat != HeaderFormat_Array;
 
-    if (options->binary || options->binaryBlob || (options->headerBlob && !taskData.combinedDefines.empty()))
+    if (!isBinaryWritten && isBinaryNeeded)
     {
         DataOutputContext context(this, finalOutputFilepath.c_str(), false);
-        if (!context.stream)
+        if (!context.IsValid())
         {
-            return;
+            return isBinaryNeeded;
         }
 
         context.WriteDataAsBinary(data, dataSize);
@@ -413,26 +695,184 @@ void Context::DumpShader(const TaskData &taskData, const uint8_t *data, size_t d
             finalOutputFilepath.c_str());
     }
 
-    if (options->header || (options->headerBlob && taskData.combinedDefines.empty()))
+    if (isHeaderNeeded)
     {
-        finalOutputFilepath += ".h"; // .h extension
-        DataOutputContext context(this, finalOutputFilepath.c_str(), true);
-        if (!context.stream)
-            return;
-
+        std::string headerFilepath = finalOutputFilepath + ".h"; // .h extension
         std::string shaderName = taskData.filepath.filename().generic_string();
 
-        context.WriteTextPreamble(shaderName.c_str(), taskData.combinedDefines);
-        context.WriteDataAsText(data, dataSize);
-        context.WriteTextEpilog();
+        if (!WriteHeader(headerFilepath, finalOutputFilepath, shaderName, taskData.combinedDefines, data, dataSize))
+            return isBinaryNeeded;
 
         Utils::Printf(WHITE "[ WRITE TO BINARY ] %s: %s \n",
             Utils::PlatformToString(options->platformType).c_str(),
-            finalOutputFilepath.c_str());
+            headerFilepath.c_str());
+    }
+
+    return isBinaryNeeded;
+}
+
+// Keeps a compiled permutation in memory until its blob and the archive are assembled.
+// Returns "false" if the memory budget is exhausted and the permutation has to go through its intermediate file.
+bool Context::AddBlobEntryData(const TaskData &taskData, const uint8_t *data, size_t dataSize)
+{
+    if (!taskData.blobEntries && !taskData.archiveEntries)
+        return true;
+
+    if (blobMemorySize.fetch_add(dataSize) + dataSize > options->blobMemoryMaxSize)
+    {
+        blobMemorySize -= dataSize;
+        return false;
     }
+
+    // Entries are distinct per task and the vectors are not resized during compilation
+    auto binary = std::make_shared<const std::vector<uint8_t>>(data, data + dataSize);
+    if (taskData.blobEntries)
+        (*taskData.blobEntries)[taskData.blobEntryIndex].data = binary;
+    if (taskData.archiveEntries)
+        (*taskData.archiveEntries)[taskData.archiveEntryIndex].data = binary;
+
+    return true;
 }
 
-bool Context::ProcessConfigLine(uint32_t lineIndex, const std::string &line, const std::filesystem::file_time_type &configTime, const char *configFilepath)
+// Writes a header in the requested format. "binaryFile" must hold the same data for "#embed" and ".incbin" headers.
+bool Context::WriteHeader(const std::string &headerFile, const std::string &binaryFile, const std::string &name, const std::string &combinedDefines, const uint8_t *data, size_t dataSize)
+{
+    std::string symbol = Utils::ToSymbolName(name);
+    std::string binaryFileName = std::filesystem::path(binaryFile).filename().generic_string();
+    std::string comment = "// {" + combinedDefines + "}\n";
+
+    // Symbols defined in separate objects are global, permutations get the suffix of their file names to stay unique
+    std::string globalSymbol = symbol;
+    if (!combinedDefines.empty())
+    {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "_%08X", Utils::HashToUint(std::hash<std::string>()(combinedDefines)));
+        globalSymbol += buf;
+    }
+
+    DataOutputContext header(this, headerFile.c_str(), true);
+    if (!header.IsValid())
+        return false;
+
+    if (options->headerFormat == HeaderFormat_Embed)
+    {
+        // The path is relative to the header
+        return header.WriteText(comment + "const uint8_t " + symbol + "[] = {\n#embed \"" + binaryFileName + "\"\n};\n");
+    }
+
+    if (options->headerFormat == HeaderFormat_Incbin)
+    {
+        // The declaration keeps "sizeof" working, the data comes from the assembly stub
+        std::string declaration = "const uint8_t " + globalSymbol + "[" + std::to_string(dataSize) + "];\n";
+        if (!header.WriteText(comment + "#ifdef __cplusplus\nextern \"C\" " + declaration + "#else\nextern " + declaration + "#endif\n"))
+            return false;
+
+        // ".incbin" paths are resolved by the assembler, the output directory must be in its include paths
+        std::string stubFile = headerFile.substr(0, headerFile.size() - 2) + ".S";
+        DataOutputContext stub(this, stubFile.c_str(), true);
+
+        return stub.IsValid() && stub.WriteText(
+            "#if defined(__APPLE__)\n"
+            "#   define SYMBOL _" + globalSymbol + "\n"
+            "    .section __TEXT,__const\n"
+            "#else\n"
+            "#   define SYMBOL " + globalSymbol + "\n"
+            "    .section .rodata\n"
+            "#endif\n"
+            "    .globl SYMBOL\n"
+            "    .balign 16\n"
+            "SYMBOL:\n"
+            "    .incbin \"" + binaryFileName + "\"\n"
+            "#if defined(__ELF__)\n"
+            "    .section .note.GNU-stack,\"\",@progbits\n"
+            "#endif\n");
+    }
+
+    if (!options->headerSplitSize || dataSize <= options->headerSplitSize)
+    {
+        header.WriteTextPreamble(symbol.c_str(), combinedDefines);
+        header.WriteDataAsText(data, dataSize);
+        header.WriteTextEpilog();
+
+        return true;
+    }
+
+    // Split into "<header>.N.c" parts, which consumers can compile in parallel
+    std::string declarations, parts, partSizes;
+    bool success = true;
+    for (size_t offset = 0, partIndex = 0; offset < dataSize && success; offset += options->headerSplitSize, partIndex++)
+    {
+        std::string partSymbol = globalSymbol + "_" + std::to_string(partIndex);
+        size_t partSize = std::min<size_t>(options->headerSplitSize, dataSize - offset);
+
+        std::string partFile = headerFile.substr(0, headerFile.size() - 2) + "." + std::to_string(partIndex) + ".c";
+        DataOutputContext part(this, partFile.c_str(), true);
+
+        success = part.IsValid() && part.WriteText("#include <stdint.h>\n\n");
+        if (success)
+        {
+            part.WriteTextPreamble(partSymbol.c_str(), combinedDefines);
+            part.WriteDataAsText(data + offset, partSize);
+            part.WriteTextEpilog();
+        }
+
+        declarations += "extern const uint8_t " + partSymbol + "[" + std::to_string(partSize) + "];\n";
+        parts += (partIndex ? ", " : "") + partSymbol;
+        partSizes += (partIndex ? ", " : "") + std::to_string(partSize);
+    }
+
+    success = success && header.WriteText(comment
+        + "#ifdef __cplusplus\nextern \"C\" {\n#endif\n"
+        + declarations
+        + "#ifdef __cplusplus\n}\n#endif\n"
+        + "static const uint8_t *const " + globalSymbol + "_parts[] = { " + parts + " };\n"
+        + "static const uint32_t " + globalSymbol + "_partSizes[] = { " + partSizes + " };\n");
+
+    return success;
+}
+
+void Context::SetTaskBinary(const TaskData &taskData, const uint8_t *data, size_t dataSize)
+{
+    if (!taskData.blob)
+        return;
+
+    taskData.blob->binary = std::make_shared<const std::vector<uint8_t>>(data, data + dataSize);
+
+    // A recompiled binary replaces the stale one
+    if (memoryCache && !taskData.memoryCacheKey.empty())
+        memoryCache->Insert(taskData.memoryCacheKey, taskData.blob->binary);
+}
+
+// Dimensions of a permutation in key order: the values listed by "{...}" for expanded defines, the only value for the others.
+// Fails if a value can't be told apart, e.g. a define expanded twice.
+static bool GetPermutationLayout(const std::string &combinedDefines, const std::vector<PermutationDimension> &expandedDimensions,
+    std::vector<PermutationDimension> &outDimensions, uint32_t &outIndex)
+{
+    outIndex = 0;
+
+    std::istringstream defines(combinedDefines);
+    std::string define;
+    while (defines >> define)
+    {
+        size_t equal = define.find('=');
+        std::string name = define.substr(0, equal);
+        std::string value = equal == std::string::npos ? "" : define.substr(equal + 1);
+
+        auto expanded = std::find_if(expandedDimensions.begin(), expandedDimensions.end(), [&name](const PermutationDimension &dimension) { return dimension.name == name; });
+        PermutationDimension &dimension = outDimensions.emplace_back(expanded != expandedDimensions.end() ? *expanded : PermutationDimension{name, {value}});
+
+        auto it = std::find(dimension.values.begin(), dimension.values.end(), value);
+        if (it == dimension.values.end())
+            return false;
+
+        outIndex = outIndex * (uint32_t)dimension.values.size() + (uint32_t)(it - dimension.values.begin());
+    }
+
+    return true;
+}
+
+bool Context::ProcessConfigLine(uint32_t lineIndex, const std::string &line, const std::filesystem::file_time_type &configTime, const char *configFilepath,
+    const std::vector<PermutationDimension> &expandedDimensions)
 {
     // Tokenize
     std::string lineCopy = line;
@@ -511,6 +951,9 @@ bool Context::ProcessConfigLine(uint32_t lineIndex, const std::string &line, con
         force = true;
     }
 
+    // Outputs produced by a different compiler are stale
+    force |= IsCompilerChanged();
+
     // Early out if no changes detected
     std::filesystem::file_time_type zero; // constructor sets to 0
     std::filesystem::file_time_type outputTime = zero;
@@ -617,6 +1060,7 @@ bool Context::ProcessConfigLine(uint32_t lineIndex, const std::string &line, con
     taskData.combinedDefines = combinedDefines;
     taskData.defines = configLine.defines;
     taskData.optimizationLevel = optimizationLevel;
+    taskData.finalOutputPathNoExtension = outputFileWithoutExt;
 
     if (options->verbose)
     {
@@ -629,48 +1073,251 @@ bool Context::ProcessConfigLine(uint32_t lineIndex, const std::string &line, con
         std::string blobName = Utils::PathToString(outputDir / shaderName);
         std::vector<BlobEntry> &entries = this->shaderBlobs[blobName];
 
+        taskData.blobEntries = &entries;
+        taskData.blobEntryIndex = entries.size();
+
         BlobEntry entry;
         entry.permutationFileWithoutExt = outputFileWithoutExt;
         entry.combinedDefines = combinedDefines;
+
+        // Permutations of a config line share the dimensions
+        std::vector<PermutationDimension> dimensions;
+        if (options->permutationIndex && GetPermutationLayout(combinedDefines, expandedDimensions, dimensions, entry.permutationIndex))
+        {
+            if (!lastPermutationDimensions || *lastPermutationDimensions != dimensions)
+                lastPermutationDimensions = std::make_shared<const std::vector<PermutationDimension>>(std::move(dimensions));
+
+            entry.dimensions = lastPermutationDimensions;
+        }
+
         entries.push_back(entry);
     }
 
+    if (!options->archive.empty())
+    {
+        std::filesystem::path archiveShaderName = configLine.outputDir ? std::filesystem::path(configLine.outputDir) / shaderName : shaderName;
+
+        taskData.archiveEntries = &archiveEntries;
+        taskData.archiveEntryIndex = archiveEntries.size();
+
+        BlobEntry entry;
+        entry.permutationFileWithoutExt = outputFileWithoutExt;
+        entry.combinedDefines = MakeArchiveKey(archiveShaderName.generic_string(), combinedDefines);
+        archiveEntries.push_back(entry);
+    }
+
+    return true;
+}
+
+bool Context::ExpandPermutations(uint32_t lineIndex, const std::string &line, const std::filesystem::file_time_type &configTime, const char *configFilepath,
+    std::vector<PermutationDimension> &expandedDimensions)
+{
+    size_t opening = line.find('{');
+    if (opening == std::string::npos)
+    {
+        return ProcessConfigLine(lineIndex, line, configTime, configFilepath, expandedDimensions);
+    }
+
+    size_t closing = line.find('}', opening);
+    if (closing == std::string::npos)
+    {
+        Utils::Printf(RED "%s(%u,0): ERROR: Missing '}'!\n", configFilepath, lineIndex + 1);
+        return false;
+    }
+
+    // Record the expanded define, e.g. "A" with values "0", "1" for "-D A={0,1}", for the permutation index
+    size_t tokenStart = line.find_last_of(" \t", opening);
+    tokenStart = tokenStart == std::string::npos ? 0 : tokenStart + 1;
+    std::string prefix = line.substr(tokenStart, opening - tokenStart);
+    if (prefix.compare(0, 2, "-D") == 0)
+        prefix.erase(0, 2);
+
+    size_t tokenEnd = line.find_first_of(" \t", closing);
+    std::string suffix = line.substr(closing + 1, tokenEnd == std::string::npos ? std::string::npos : tokenEnd - closing - 1);
+
+    size_t equal = prefix.find('=');
+    PermutationDimension dimension;
+    if (equal != std::string::npos)
+        dimension.name = prefix.substr(0, equal);
+
+    size_t current = opening + 1;
+    while (true)
+    {
+        size_t comma = line.find(',', current);
+        if (comma == std::string::npos || comma > closing)
+        {
+            comma = closing;
+        }
+
+        if (!dimension.name.empty())
+            dimension.values.push_back(prefix.substr(equal + 1) + line.substr(current, comma - current) + suffix);
+
+        current = comma + 1;
+        if (comma >= closing)
+            break;
+    }
+
+    if (!dimension.name.empty())
+        expandedDimensions.push_back(dimension);
+
+    current = opening + 1;
+    while (true)
+    {
+        size_t comma = line.find(',', current);
+        if (comma == std::string::npos || comma > closing)
+        {
+            comma = closing;
+        }
+
+        std::string newConfig = line.substr(0, opening) + line.substr(current, comma - current) + line.substr(closing + 1);
+        if (!ExpandPermutations(lineIndex, newConfig, configTime, configFilepath, expandedDimensions))
+        {
+            return false;
+        }
+
+        current = comma + 1;
+        if (comma >= closing)
+            break;
+    }
+
+    if (!dimension.name.empty())
+        expandedDimensions.pop_back();
+
+    return true;
+}
+
+// Dictionary training looks at the first permutations of a blob, up to this size
+#define BLOB_DICTIONARY_MAX_SAMPLES_SIZE (64 << 20)
+
+// Dense permutation index tables larger than that are not created (4 bytes per index)
+#define PERMUTATION_INDEX_MAX_SIZE (1 << 20)
+
+// Dimensions of the permutations of a blob and the dense index of every permutation (mixed radix, the last define varies
+// the fastest). The dimensions recorded by "ExpandPermutations" keep the index layout stable, even if only some permutations
+// are rebuilt. Otherwise they are deduced from the keys, with values in order of appearance.
+// Fails if the permutations don't share the same defines.
+static bool GetPermutationDimensions(const std::vector<BlobEntry> &entries, std::vector<PermutationDimension> &outDimensions, std::vector<uint32_t> &outIndices)
+{
+    bool isRecorded = !entries.empty() && entries[0].dimensions;
+    for (size_t i = 1; i < entries.size() && isRecorded; i++)
+        isRecorded = entries[i].dimensions && (entries[i].dimensions == entries[0].dimensions || *entries[i].dimensions == *entries[0].dimensions);
+
+    std::vector<uint32_t> valueIndices;
+    if (isRecorded)
+        outDimensions = *entries[0].dimensions;
+    else
+    {
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            // "combinedDefines" is "NAME=value" pairs sorted by name
+            std::istringstream defines(entries[i].combinedDefines);
+            std::string define;
+            size_t dimension = 0;
+            while (defines >> define)
+            {
+                size_t equal = define.find('=');
+                std::string name = define.substr(0, equal);
+                std::string value = equal == std::string::npos ? "" : define.substr(equal + 1);
+
+                if (i == 0)
+                    outDimensions.push_back({name, {}});
+                else if (dimension >= outDimensions.size() || outDimensions[dimension].name != name)
+                    return false;
+
+                std::vector<std::string> &values = outDimensions[dimension].values;
+                auto it = std::find(values.begin(), values.end(), value);
+                valueIndices.push_back((uint32_t)(it - values.begin()));
+                if (it == values.end())
+                    values.push_back(value);
+
+                dimension++;
+            }
+
+            if (dimension != outDimensions.size())
+                return false;
+        }
+    }
+
+    if (outDimensions.empty())
+        return false;
+
+    uint64_t indexSize = 1;
+    for (const PermutationDimension &dimension : outDimensions)
+    {
+        indexSize *= dimension.values.size();
+        if (indexSize > PERMUTATION_INDEX_MAX_SIZE)
+            return false;
+    }
+
+    outIndices.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (isRecorded)
+        {
+            outIndices[i] = entries[i].permutationIndex;
+            continue;
+        }
+
+        uint32_t index = 0;
+        for (size_t j = 0; j < outDimensions.size(); j++)
+            index = index * (uint32_t)outDimensions[j].values.size() + valueIndices[i * outDimensions.size() + j];
+
+        outIndices[i] = index;
+    }
+
+    return true;
+}
+
+static bool WriteDataToVectorCallback(const void *data, size_t size, void *context)
+{
+    std::vector<uint8_t> &buffer = *(std::vector<uint8_t> *)context;
+    buffer.insert(buffer.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+
     return true;
 }
 
-bool Context::ExpandPermutations(uint32_t lineIndex, const std::string &line, const std::filesystem::file_time_type &configTime, const char *configFilepath)
+// Patches leave out the permutations identical in the base, see "Options::patchBaseDir"
+static bool IsInPatchBase(const BlobView &base, const std::string &key, const std::vector<uint8_t> &data, std::vector<uint8_t> &scratch)
 {
-    size_t opening = line.find('{');
-    if (opening == std::string::npos)
+    PermutationKey permutationKey(key);
+
+    std::span<const uint8_t> baseData;
+    if (!base.Find(permutationKey, baseData))
     {
-        return ProcessConfigLine(lineIndex, line, configTime, configFilepath);
+        if (!base.Read(permutationKey, scratch))
+            return false;
+
+        baseData = scratch;
     }
 
-    size_t closing = line.find('}', opening);
-    if (closing == std::string::npos)
+    return baseData.size() == data.size() && memcmp(baseData.data(), data.data(), data.size()) == 0;
+}
+
+bool Context::OpenPatchBase(const std::string &outputFile, BlobView &outBase)
+{
+    if (options->patchBaseDir.empty())
+        return false;
+
+    // The base build has the same layout as the output directory
+    std::filesystem::path relativePath = std::filesystem::path(outputFile).lexically_relative(options->baseDirectory / options->outputDir);
+    if (relativePath.empty() || *relativePath.begin() == "..")
+        relativePath = std::filesystem::path(outputFile).filename();
+
+    std::filesystem::path baseFile = options->patchBaseDir / relativePath;
+    if (!std::filesystem::exists(baseFile))
     {
-        Utils::Printf(RED "%s(%u,0): ERROR: Missing '}'!\n", configFilepath, lineIndex + 1);
+        if (options->verbose)
+            Utils::Printf(WHITE "'%s' has no base '%s', written in full\n", outputFile.c_str(), Utils::PathToString(baseFile).c_str());
+
         return false;
     }
 
-    size_t current = opening + 1;
-    while (true)
+    if (!outBase.Open(baseFile) || outBase.GetVersion() == 0)
     {
-        size_t comma = line.find(',', current);
-        if (comma == std::string::npos || comma > closing)
-        {
-            comma = closing;
-        }
-
-        std::string newConfig = line.substr(0, opening) + line.substr(current, comma - current) + line.substr(closing + 1);
-        if (!ExpandPermutations(lineIndex, newConfig, configTime, configFilepath))
-        {
-            return false;
-        }
+        Utils::Printf(YELLOW "WARNING: Base '%s' is not a valid blob, '%s' is written in full\n", Utils::PathToString(baseFile).c_str(), outputFile.c_str());
+        outBase.Close();
 
-        current = comma + 1;
-        if (comma >= closing)
-            break;
+        return false;
     }
 
     return true;
@@ -681,43 +1328,98 @@ bool Context::CreateBlob(const std::string &blobName, const std::vector<BlobEntr
     // Create output file
     std::string outputFile = blobName;
     outputFile += options->outputExt;
-    if (useTextOutput)
-        outputFile += ".h";
 
-    DataOutputContext outputContext(this, outputFile.c_str(), useTextOutput);
-    if (!outputContext.stream)
+    // Binary blobs are streamed into the file, headers are produced from the whole blob
+    std::optional<DataOutputContext> outputContext;
+    std::vector<uint8_t> blobData;
+
+    ShaderMake::WriteFileCallback writeFileCallback = &WriteDataToVectorCallback;
+    void *writeFileContext = &blobData;
+
+    if (!useTextOutput)
     {
-        Utils::Printf(RED "ERROR: Can''t open 'output file '%s'!\n", outputFile.c_str());
-        return false;
+        outputContext.emplace(this, outputFile.c_str(), false);
+        if (!outputContext->IsValid())
+        {
+            Utils::Printf(RED "ERROR: Can''t open 'output file '%s'!\n", outputFile.c_str());
+            return false;
+        }
+
+        writeFileCallback = &DataOutputContext::WriteDataAsBinaryCallback;
+        writeFileContext = &*outputContext;
     }
 
-    if (useTextOutput)
+    // v2 blobs are written through "BlobWriter", v1 blobs start with a header
+    std::optional<BlobWriter> blobWriter;
+    std::vector<uint32_t> permutationIndices;
+    if (options->IsBlobV2())
     {
-        outputContext.WriteTextPreamble(blobName.c_str(), "");
-    }
+        BlobWriterSettings settings;
+        settings.compress = options->blobCompression;
+        settings.deduplicate = options->blobDeduplication;
+        settings.alignment = options->blobAlignment;
+        settings.checksums = options->blobChecksums;
+        if (settings.compress && options->blobDictionarySize)
+            settings.dictionary = TrainBlobDictionary(entries);
+
+        if (options->permutationIndex)
+        {
+            std::vector<PermutationDimension> dimensions;
+            if (GetPermutationDimensions(entries, dimensions, permutationIndices))
+            {
+                settings.indexSize = 1;
+                for (const PermutationDimension &dimension : dimensions)
+                    settings.indexSize *= (uint32_t)dimension.values.size();
+                settings.dimensions = dimensions;
 
-    ShaderMake::WriteFileCallback writeFileCallback = useTextOutput
-        ? &DataOutputContext::WriteDataAsTextCallback
-        : &DataOutputContext::WriteDataAsBinaryCallback;
+                // Text and binary blobs share the header
+                if ((!useTextOutput || !options->binaryBlob) && !WritePermutationIndexHeader(blobName, dimensions))
+                    return false;
+            }
+            else
+            {
+                Utils::Printf(YELLOW "WARNING: Blob '%s' gets no permutation index, its permutations don't share the same defines or are too many\n", outputFile.c_str());
+                permutationIndices.clear();
+            }
+        }
 
-    // Write "blob" header
-    if (!ShaderMake::WriteFileHeader(writeFileCallback, &outputContext))
+        blobWriter.emplace(writeFileCallback, writeFileContext, settings);
+    }
+    else if (!ShaderMake::WriteFileHeader(writeFileCallback, writeFileContext))
     {
         Utils::Printf(RED "ERROR: Failed to write into output file '%s'!\n", outputFile.c_str());
         return false;
     }
 
+    // Binary blobs become patches over the base build, headers are always complete
+    BlobView patchBase;
+    bool isPatch = !useTextOutput && OpenPatchBase(outputFile, patchBase);
+    std::vector<uint8_t> patchScratch;
+    uint32_t unchangedNum = 0;
+
     bool success = true;
 
     // Collect individual permutations
     for (const BlobEntry &entry : entries)
     {
-        // Open compiled permutation file
-        std::string file = entry.permutationFileWithoutExt + options->outputExt;
+        // Take the compiled permutation from memory, or open its file if it has been spilled
         std::vector<uint8_t> fileData;
-        if (Utils::ReadBinaryFile(file.c_str(), fileData))
+        std::string file = entry.permutationFileWithoutExt + options->outputExt;
+        if (entry.data || Utils::ReadBinaryFile(file.c_str(), fileData))
         {
-            if (!ShaderMake::WritePermutation(writeFileCallback, &outputContext, entry.combinedDefines, fileData.data(), fileData.size()))
+            const std::vector<uint8_t> &permutationData = entry.data ? *entry.data : fileData;
+            if (isPatch && IsInPatchBase(patchBase, entry.combinedDefines, permutationData, patchScratch))
+            {
+                unchangedNum++;
+                continue;
+            }
+
+            uint32_t permutationIndex = permutationIndices.empty() ? ~0u : permutationIndices[&entry - entries.data()];
+            bool isWritten = blobWriter
+                ? blobWriter->AddPermutation(entry.combinedDefines, permutationData.data(), permutationData.size(), permutationIndex)
+                : ShaderMake::WritePermutation(writeFileCallback, writeFileContext, entry.combinedDefines, permutationData.data(), permutationData.size());
+
+            if (!isWritten)
             {
                 Utils::Printf(RED "ERROR: Failed to write a shader permutation into '%s'!\n", outputFile.c_str());
                 success = false;
@@ -730,21 +1432,240 @@ bool Context::CreateBlob(const std::string &blobName, const std::vector<BlobEntr
             break;
     }
 
-    if (useTextOutput)
-        outputContext.WriteTextEpilog();
+    if (isPatch)
+    {
+        patchUnchangedCount += unchangedNum;
+
+        if (options->verbose)
+            Utils::Printf(WHITE "Blob '%s': patch with %zu of %zu permutation(s)\n", outputFile.c_str(), entries.size() - unchangedNum, entries.size());
+    }
+
+    if (success && blobWriter)
+    {
+        success = blobWriter->Finish();
+        if (!success)
+            Utils::Printf(RED "ERROR: Failed to write into output file '%s'!\n", outputFile.c_str());
+        else
+        {
+            if (options->verbose && (options->blobCompression || blobWriter->GetDuplicateNum()))
+            {
+                Utils::Printf(WHITE "Blob '%s': %zu permutation(s) (%u duplicate), %llu -> %llu bytes (%.1f%%)\n",
+                    outputFile.c_str(), entries.size(), blobWriter->GetDuplicateNum(),
+                    (unsigned long long)blobWriter->GetDataSize(), (unsigned long long)blobWriter->GetWrittenSize(),
+                    100.0 * blobWriter->GetWrittenSize() / std::max<uint64_t>(blobWriter->GetDataSize(), 1));
+            }
+
+            // A header blob next to a binary blob holds the same permutations, count them once
+            if (!useTextOutput || !options->binaryBlob)
+            {
+                blobDuplicateCount += blobWriter->GetDuplicateNum();
+                blobDuplicateSize += blobWriter->GetDuplicateSize();
+            }
+        }
+    }
+
+    if (success && useTextOutput)
+    {
+        // "#embed" and ".incbin" headers reference the binary blob
+        if (options->headerFormat != HeaderFormat_Array && !options->binaryBlob)
+        {
+            DataOutputContext binaryContext(this, outputFile.c_str(), false);
+            success = binaryContext.IsValid() && binaryContext.WriteDataAsBinary(blobData.data(), blobData.size());
+        }
+
+        std::string headerFile = outputFile + ".h";
+        success = success && WriteHeader(headerFile, outputFile, blobName, "", blobData.data(), blobData.size());
+
+        if (!success)
+            Utils::Printf(RED "ERROR: Failed to write into output file '%s'!\n", headerFile.c_str());
+    }
 
     return success;
 }
 
+// A struct with a typed field per define, which computes the dense index of a permutation at compile time
+bool Context::WritePermutationIndexHeader(const std::string &blobName, const std::vector<PermutationDimension> &dimensions)
+{
+    std::string headerFile = blobName + ".permutations.h";
+    std::string symbol = Utils::ToSymbolName(std::filesystem::path(blobName).filename().generic_string()) + "_Permutation";
+
+    std::string enums;
+    std::string fields;
+    std::string index;
+    uint32_t stride = 1;
+    for (size_t i = dimensions.size(); i-- > 0;)
+    {
+        const PermutationDimension &dimension = dimensions[i];
+        std::string name = Utils::ToSymbolName(dimension.name);
+        std::string type = name + "_Value";
+
+        // Values become enumerators, the original value is kept in a comment if it's not a valid identifier
+        std::vector<std::string> enumerators;
+        std::string enumeratorList;
+        for (const std::string &value : dimension.values)
+        {
+            std::string enumerator = Utils::ToSymbolName(value);
+            if (std::find(enumerators.begin(), enumerators.end(), enumerator) != enumerators.end())
+                enumerator += "_" + std::to_string(enumerators.size());
+
+            enumeratorList += "        " + enumerator + ",";
+            if (enumerator != value)
+                enumeratorList += " // " + value;
+            enumeratorList += "\n";
+
+            enumerators.push_back(enumerator);
+        }
+
+        enums = "    enum class " + type + " : uint32_t\n    {\n" + enumeratorList + "    };\n\n" + enums;
+        fields = "    " + type + " " + name + " = " + type + "::" + enumerators[0] + ";\n" + fields;
+
+        std::string term = "(uint32_t)" + name + (stride > 1 ? " * " + std::to_string(stride) : "");
+        index = index.empty() ? term : term + " + " + index;
+
+        stride *= (uint32_t)dimension.values.size();
+    }
+
+    std::string text =
+        "// Generated by ShaderMake, dense permutation indices of the blob '" + std::filesystem::path(blobName).filename().generic_string() + "',\n"
+        "// see \"ShaderMake::FindPermutationInBlobByIndex\". Use as \"" + symbol + "{ ." + Utils::ToSymbolName(dimensions[0].name) + " = ... }.GetIndex()\".\n"
+        "#pragma once\n"
+        "\n"
+        "#include <cstdint>\n"
+        "\n"
+        "struct " + symbol + "\n"
+        "{\n" +
+        enums +
+        fields +
+        "\n"
+        "    static constexpr uint32_t Count = " + std::to_string(stride) + ";\n"
+        "\n"
+        "    constexpr uint32_t GetIndex() const\n"
+        "    {\n"
+        "        return " + index + ";\n"
+        "    }\n"
+        "};\n";
+
+    DataOutputContext header(this, headerFile.c_str(), true);
+    if (!header.IsValid() || !header.WriteText(text))
+    {
+        Utils::Printf(RED "ERROR: Failed to write into output file '%s'!\n", headerFile.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Permutations of a blob are the samples for its compression dictionary
+std::vector<uint8_t> Context::TrainBlobDictionary(const std::vector<BlobEntry> &entries)
+{
+    std::vector<uint8_t> samples;
+    std::vector<size_t> sampleSizes;
+
+    for (const BlobEntry &entry : entries)
+    {
+        std::vector<uint8_t> fileData;
+        std::string file = entry.permutationFileWithoutExt + options->outputExt;
+        if (!entry.data && !Utils::ReadBinaryFile(file.c_str(), fileData))
+            continue;
+
+        const std::vector<uint8_t> &permutationData = entry.data ? *entry.data : fileData;
+        if (samples.size() + permutationData.size() > BLOB_DICTIONARY_MAX_SAMPLES_SIZE)
+            break;
+
+        samples.insert(samples.end(), permutationData.begin(), permutationData.end());
+        sampleSizes.push_back(permutationData.size());
+    }
+
+    // About twice the average permutation: enough for the content they share, larger dictionaries crowd the match finder
+    size_t dictionarySize = sampleSizes.empty() ? 0 : 2 * samples.size() / sampleSizes.size();
+
+    return TrainDictionary(samples.data(), sampleSizes, std::min<size_t>(dictionarySize, options->blobDictionarySize));
+}
+
 void Context::RemoveIntermediateBlobFiles(const std::vector<BlobEntry> &entries)
 {
+    // Only spilled permutations have intermediate files
     for (const BlobEntry &entry : entries)
     {
+        if (entry.data)
+            continue;
+
         std::string file = entry.permutationFileWithoutExt + options->outputExt;
         std::filesystem::remove(file);
     }
 }
 
+bool Context::CreateArchive()
+{
+    std::string outputFile = Utils::PathToString(options->baseDirectory / options->outputDir / options->archive);
+
+    DataOutputContext outputContext(this, outputFile.c_str(), false);
+    if (!outputContext.IsValid())
+        return false;
+
+    // Payloads stay uncompressed to be used in place, identical ones are shared across shaders
+    BlobWriterSettings settings;
+    settings.deduplicate = options->blobDeduplication;
+    settings.alignment = options->blobAlignment;
+    settings.checksums = options->blobChecksums;
+
+    BlobWriter blobWriter(&DataOutputContext::WriteDataAsBinaryCallback, &outputContext, settings);
+
+    BlobView patchBase;
+    bool isPatch = OpenPatchBase(outputFile, patchBase);
+    std::vector<uint8_t> patchScratch;
+    uint32_t unchangedNum = 0;
+
+    // Sorted for a deterministic payload order, and to detect shaders produced more than once
+    std::vector<const BlobEntry *> sortedEntries;
+    sortedEntries.reserve(archiveEntries.size());
+    for (const BlobEntry &entry : archiveEntries)
+        sortedEntries.push_back(&entry);
+
+    std::sort(sortedEntries.begin(), sortedEntries.end(), [](const BlobEntry *a, const BlobEntry *b) { return a->combinedDefines < b->combinedDefines; });
+
+    for (size_t i = 0; i < sortedEntries.size(); i++)
+    {
+        const BlobEntry &entry = *sortedEntries[i];
+        if (i && entry.combinedDefines == sortedEntries[i - 1]->combinedDefines)
+        {
+            Utils::Printf(YELLOW "WARNING: Shader '%s' is produced more than once, only the first one is archived\n", entry.combinedDefines.c_str());
+            continue;
+        }
+
+        std::vector<uint8_t> fileData;
+        std::string file = entry.permutationFileWithoutExt + options->outputExt;
+        if (!entry.data && !Utils::ReadBinaryFile(file.c_str(), fileData))
+            return false;
+
+        const std::vector<uint8_t> &permutationData = entry.data ? *entry.data : fileData;
+        if (isPatch && IsInPatchBase(patchBase, entry.combinedDefines, permutationData, patchScratch))
+        {
+            unchangedNum++;
+            continue;
+        }
+
+        if (!blobWriter.AddPermutation(entry.combinedDefines, permutationData.data(), permutationData.size()))
+        {
+            Utils::Printf(RED "ERROR: Failed to write into output file '%s'!\n", outputFile.c_str());
+            return false;
+        }
+    }
+
+    if (!blobWriter.Finish())
+    {
+        Utils::Printf(RED "ERROR: Failed to write into output file '%s'!\n", outputFile.c_str());
+        return false;
+    }
+
+    Utils::Printf(WHITE "Archive '%s': %zu shader(s) (%u duplicate), %llu bytes\n",
+        outputFile.c_str(), sortedEntries.size() - unchangedNum, blobWriter.GetDuplicateNum(), (unsigned long long)blobWriter.GetWrittenSize());
+
+    patchUnchangedCount += unchangedNum;
+
+    return true;
+}
+
 CompileStatus Context::CompileShader(std::vector<std::shared_ptr<ShaderContext>> shaderContexts)
 {
     if (shaderContexts.size() < 1)
@@ -754,6 +1675,26 @@ CompileStatus Context::CompileShader(std::vector<std::shared_ptr<ShaderContext>>
 
     for (auto &shader : shaderContexts)
     {
+        // Everything affecting the binary identifies it in the memory cache
+        std::string memoryCacheKey = shader->GetFilepath() + '|' + ShaderTypeToProfile(shader->GetType()) + '|' + shader->GetDesc().entryPoint + '|'
+            + shader->GetDesc().shaderModel + '|' + std::to_string(shader->GetDesc().optimizationLevel);
+        for (const std::string &define : shader->GetDesc().defines)
+            memoryCacheKey += '|' + define;
+
+        bool isReusable = !shader->IsForceRecompile() && !IsCompilerChanged();
+
+        // Repeated requests are served from memory without touching the file system
+        if (MemoryCache::Binary binary = (isReusable && memoryCache) ? memoryCache->Find(memoryCacheKey) : nullptr)
+        {
+            getBinary = true;
+            shader->blob.binary = binary;
+
+            if (options->verbose)
+                Utils::Printf(YELLOW "Get shader from memory: " WHITE "'%s'\n", shader->GetFilepath().c_str());
+
+            continue;
+        }
+
         std::filesystem::path fullpath = options->baseDirectory / shader->GetFilepath();
         assert(std::filesystem::exists(fullpath));
 
@@ -774,22 +1715,27 @@ CompileStatus Context::CompileShader(std::vector<std::shared_ptr<ShaderContext>>
             std::filesystem::create_directories(endPath);
         }
 
-        // check if the binary exists (and not force compile active)
+        // check if the binary already exists on disk (and not force compile active)
         std::filesystem::path binaryFilepath = outputDir / fullpath.filename().replace_extension(options->outputExt);
-        if (std::ifstream binFile(binaryFilepath, std::ios::binary); binFile.is_open() && !shader->IsForceRecompile())
+        if (std::ifstream binFile(binaryFilepath, std::ios::binary); binFile.is_open() && isReusable)
         {
             getBinary = true;
 
             binFile.seekg(0, std::ios::end);
             size_t fileSize = static_cast<size_t>(binFile.tellg());
-            shader->blob.data.resize(fileSize / sizeof(uint8_t));
+            std::shared_ptr<std::vector<uint8_t>> data = std::make_shared<std::vector<uint8_t>>(fileSize);
 
             binFile.seekg(0, std::ios::beg);
-            binFile.read(reinterpret_cast<char *>(shader->blob.data.data()), fileSize);
+            binFile.read(reinterpret_cast<char *>(data->data()), fileSize);
     
             binFile.close();
 
-            Utils::Printf(YELLOW "Get shader from compiled binary: " WHITE "'%s'\n", shader->GetFilepath().c_str());
+            shader->blob.binary = data;
+            if (memoryCache)
+                memoryCache->Insert(memoryCacheKey, shader->blob.binary);
+
+            if (options->verbose)
+                Utils::Printf(YELLOW "Get shader from compiled binary: " WHITE "'%s'\n", shader->GetFilepath().c_str());
         }
         else
         {
@@ -802,6 +1748,8 @@ CompileStatus Context::CompileShader(std::vector<std::shared_ptr<ShaderContext>>
             taskData.defines = shader->GetDesc().defines;
             taskData.optimizationLevel = std::min(shader->GetDesc().optimizationLevel, 3u);
             taskData.entryPoint = shader->GetDesc().entryPoint;
+            taskData.finalOutputPathNoExtension = outputFileWithoutExt;
+            taskData.memoryCacheKey = memoryCacheKey;
 
             taskData.blob = &shader->blob; // for compile result
         }
@@ -870,7 +1818,8 @@ CompileStatus Context::CompileConfigFile(const std::string &configFilename)
         }
         else if (blocks.back())
         {
-            if (!ExpandPermutations(lineIndex, line, configTime, configFilepath.generic_string().c_str()))
+            std::vector<PermutationDimension> expandedDimensions;
+            if (!ExpandPermutations(lineIndex, line, configTime, configFilepath.generic_string().c_str(), expandedDimensions))
             {
                 return CompileStatus::Error;
             }
@@ -892,6 +1841,10 @@ bool Context::ProcessTasks()
         processedTaskCount = 0;
         failedTaskCount = 0;
 
+        // Sources may have been edited since the previous run (hot reload), don't reuse stale timestamps and hashes
+        hierarchicalUpdateTimes.clear();
+        hierarchicalContentHashes.clear();
+
         // Retry limit for compilation task sub-process failures that can occur when threading
         taskRetryCount = options->retryCount;
         
@@ -913,6 +1866,17 @@ bool Context::ProcessTasks()
         compiler.ExeCompile();
 #endif
 
+        // Spilled permutations must be on disk before blobs are assembled
+        if (writer)
+            writer->Flush();
+
+        // The archive holds all shaders, an incomplete one is not written
+        if (!archiveEntries.empty() && !failedTaskCount && !terminate)
+        {
+            if (!CreateArchive() && !options->continueOnError)
+                return false;
+        }
+
         // Dump shader blobs
         for (const auto &[blobName, blobEntries] : shaderBlobs)
         {
@@ -971,6 +1935,56 @@ bool Context::ProcessTasks()
             }
         }
 
+        // Permutations spilled for the archive only are intermediate files, except single permutations of binary blobs
+        if (!options->binary)
+        {
+            for (const BlobEntry &entry : archiveEntries)
+            {
+                if (!entry.data && !(options->binaryBlob && entry.combinedDefines.back() == ':'))
+                    std::filesystem::remove(entry.permutationFileWithoutExt + options->outputExt);
+            }
+        }
+
+        // Blobs are written, release the permutations kept for them
+        shaderBlobs.clear();
+        archiveEntries.clear();
+        blobMemorySize = 0;
+
+        if (writer)
+            writer->Flush();
+
+        uint32_t unchangedCount = unchangedOutputCount.exchange(0) + (writer ? writer->TakeUnchangedNum() : 0);
+        if (unchangedCount)
+            Utils::Printf(WHITE "%u output(s) unchanged, not rewritten.\n", unchangedCount);
+
+        if (patchUnchangedCount)
+        {
+            Utils::Printf(WHITE "%u permutation(s) unchanged since the base build, left out of patches.\n", patchUnchangedCount);
+            patchUnchangedCount = 0;
+        }
+
+        if (blobDuplicateCount)
+        {
+            Utils::Printf(WHITE "%u duplicate permutation(s) stored once in blobs, %llu bytes saved.\n",
+                blobDuplicateCount, (unsigned long long)blobDuplicateSize);
+
+            blobDuplicateCount = 0;
+            blobDuplicateSize = 0;
+        }
+
+        if (cache)
+        {
+            // Uploads run in the background during the build, only the tail is waited for
+            if (cache->GetRemote())
+                cache->GetRemote()->Flush();
+
+            cache->UpdateStats(compiler.GetCacheStats());
+        }
+
+        // Outputs are consistent with the current compiler only if everything succeeded
+        if (!failedTaskCount && !terminate)
+            UpdateCompilerStamp();
+
         // Report failed tasks
         if (failedTaskCount)
         {
@@ -1037,9 +2051,21 @@ void Context::ProcessOptions()
     options->colorize = true;
 }
 
+// Header text is formatted into a buffer of this size and written in chunks
+#define TEXT_OUTPUT_BUFFER_SIZE (256 << 10)
+
+// Larger outputs are streamed instead of being kept in memory
+#define DEFERRED_OUTPUT_MAX_SIZE (64 << 20)
+
 DataOutputContext::DataOutputContext(Context *ctx, const char *file, bool textMode)
-    : m_Ctx(ctx)
+    : m_Ctx(ctx), m_File(file), m_IsText(textMode)
 {
+    // Content is collected in memory: for the asynchronous writer, or to be compared with the existing file
+    m_WriteIfChanged = ctx && ctx->options && ctx->options->writeIfChanged;
+    m_IsDeferred = ctx && (ctx->writer || m_WriteIfChanged);
+    if (m_IsDeferred)
+        return;
+
     stream = fopen(file, textMode ? "w" : "wb");
     if (!stream)
     {
@@ -1049,55 +2075,179 @@ DataOutputContext::DataOutputContext(Context *ctx, const char *file, bool textMo
 
 DataOutputContext::~DataOutputContext()
 {
-    if (stream)
+    FlushText();
+
+    if (m_IsDeferred)
+    {
+        if (m_Ctx->writer)
+            m_Ctx->writer->Write(m_File, std::move(m_Data), m_IsText);
+        else if (IsOutputUnchanged(m_File, m_Data.data(), m_Data.size(), m_IsText))
+            m_Ctx->unchangedOutputCount++;
+        else if (!WriteOutputFile(m_File, m_Data.data(), m_Data.size(), m_IsText))
+            Utils::Printf(RED "ERROR: Can't write file '%s'!\n", m_File.c_str());
+    }
+    else if (stream)
     {
         fclose(stream);
         stream = nullptr;
+
+        // Streamed into a temporary file, which replaces the output only if the content differs
+        if (!m_TempFile.empty())
+        {
+            std::error_code ec;
+            uint64_t fileSize = std::filesystem::file_size(m_TempFile, ec);
+            if (!ec && IsOutputUnchanged(m_File, fileSize, m_Hasher.Finalize(), m_IsText))
+            {
+                std::filesystem::remove(m_TempFile, ec);
+                m_Ctx->unchangedOutputCount++;
+            }
+            else
+            {
+                std::filesystem::rename(m_TempFile, m_File, ec);
+                if (ec)
+                    Utils::Printf(RED "ERROR: Can't write file '%s'!\n", m_File.c_str());
+            }
+        }
+    }
+}
+
+bool DataOutputContext::Write(const void *data, size_t size)
+{
+    if (m_IsDeferred)
+    {
+        if (m_Data.size() + size <= DEFERRED_OUTPUT_MAX_SIZE)
+        {
+            m_Data.insert(m_Data.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+            return true;
+        }
+
+        // Too big to be kept in memory, continue synchronously
+        m_IsDeferred = false;
+
+        if (m_WriteIfChanged)
+            m_TempFile = m_File + ".tmp";
+
+        const std::string &file = m_TempFile.empty() ? m_File : m_TempFile;
+        stream = fopen(file.c_str(), m_IsText ? "w" : "wb");
+        if (!stream)
+        {
+            Utils::Printf(RED "ERROR: Can't open file '%s' for writing!\n", file.c_str());
+            return false;
+        }
+
+        m_Hasher.Update(m_Data.data(), m_Data.size());
+
+        bool success = m_Data.empty() || fwrite(m_Data.data(), m_Data.size(), 1, stream) == 1;
+        std::vector<uint8_t>().swap(m_Data);
+
+        if (!success)
+            return false;
     }
+
+    if (!stream)
+        return false;
+
+    if (!m_TempFile.empty())
+        m_Hasher.Update(data, size);
+
+    return size == 0 || fwrite(data, size, 1, stream) == 1;
+}
+
+bool DataOutputContext::FlushText()
+{
+    bool success = m_TextSize == 0 || Write(m_TextBuffer.data(), m_TextSize);
+    m_TextSize = 0;
+
+    return success;
+}
+
+// Decimal "N," for every byte value, precomputed once
+struct ByteText
+{
+    char text[5];
+    uint32_t length;
+};
+
+static std::array<ByteText, 256> BuildByteTextTable()
+{
+    std::array<ByteText, 256> table = {};
+    for (uint32_t i = 0; i < 256; i++)
+        table[i].length = (uint32_t)snprintf(table[i].text, sizeof(table[i].text), "%u,", i);
+
+    return table;
 }
 
 bool DataOutputContext::WriteDataAsText(const void *data, size_t size)
 {
+    static const std::array<ByteText, 256> decimalTable = BuildByteTextTable();
+    static const char hexDigits[] = "0123456789ABCDEF";
+
+    // Worst case per byte: a line break and "0xAB,"
+    const size_t maxBytesPerValue = 10;
+
+    if (m_TextBuffer.empty())
+        m_TextBuffer.resize(TEXT_OUTPUT_BUFFER_SIZE);
+
+    const bool isHex = m_Ctx && m_Ctx->options && m_Ctx->options->headerHex;
+    const uint8_t *bytes = (const uint8_t *)data;
+
     for (size_t i = 0; i < size; i++)
     {
-        uint8_t value = ((const uint8_t *)data)[i];
+        if (m_TextSize + maxBytesPerValue > m_TextBuffer.size() && !FlushText())
+            return false;
+
+        char *p = m_TextBuffer.data() + m_TextSize;
+        uint8_t value = bytes[i];
 
         if (m_lineLength > 128)
         {
-            fprintf(stream, "\n    ");
+            memcpy(p, "\n    ", 5);
+            p += 5;
             m_lineLength = 0;
         }
 
-        fprintf(stream, "%u,", value);
-
-        if (value < 10)
-            m_lineLength += 3;
-        else if (value < 100)
-            m_lineLength += 4;
+        uint32_t length;
+        if (isHex)
+        {
+            p[0] = '0';
+            p[1] = 'x';
+            p[2] = hexDigits[value >> 4];
+            p[3] = hexDigits[value & 0xF];
+            p[4] = ',';
+            length = 5;
+        }
         else
-            m_lineLength += 5;
+        {
+            const ByteText &text = decimalTable[value];
+            memcpy(p, text.text, 4);
+            length = text.length;
+        }
+
+        m_TextSize = (p + length) - m_TextBuffer.data();
+        m_lineLength += length + 1;
     }
 
     return true;
 }
 
+bool DataOutputContext::WriteText(const std::string &text)
+{
+    return FlushText() && Write(text.data(), text.size());
+}
+
 void DataOutputContext::WriteTextPreamble(const char *shaderName, const std::string &combinedDefines)
 {
-    fprintf(stream, "// {%s}\n", combinedDefines.c_str());
-    fprintf(stream, "const uint8_t %s[] = {", shaderName);
+    WriteText("// {" + combinedDefines + "}\nconst uint8_t " + shaderName + "[] = {");
 }
 
 void DataOutputContext::WriteTextEpilog()
 {
-    fprintf(stream, "\n};\n");
+    WriteText("\n};\n");
 }
 
 bool DataOutputContext::WriteDataAsBinary(const void *data, size_t size)
 {
-    if (size == 0)
-        return true;
-
-    return fwrite(data, size, 1, stream) == 1;
+    return Write(data, size);
 }
 
 // For use as a callback in "WriteFileHeader" and "WritePermutation" functions
@@ -0,0 +1,533 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "FileWriter.h"
+#include "Context.h"
+#include "Hash.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#   define SHADERMAKE_URING 1
+#   include <linux/io_uring.h>
+#   include <sys/syscall.h>
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <errno.h>
+#else
+#   define SHADERMAKE_URING 0
+#endif
+
+namespace ShaderMake {
+
+// Files taken by the writer thread at once, each one needs up to 2 submission queue entries (write + close)
+#define FILE_WRITER_BATCH_SIZE 64
+
+// Producers wait if more than that is queued
+#define FILE_WRITER_MAX_PENDING_BYTES (256 << 20)
+
+// Existing outputs are read back in chunks of this size for comparison
+#define OUTPUT_COMPARE_CHUNK_SIZE (1 << 20)
+
+#if SHADERMAKE_URING
+
+// Minimal io_uring wrapper on top of raw syscalls
+struct Uring
+{
+    int fd = -1;
+
+    void *sqRing = MAP_FAILED;
+    void *cqRing = MAP_FAILED;
+    io_uring_sqe *sqes = (io_uring_sqe *)MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned sqLocalTail = 0;
+    unsigned sqQueuedNum = 0;
+
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    io_uring_cqe *cqes = nullptr;
+    unsigned cqMask = 0;
+
+    ~Uring()
+    {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing)
+            munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED)
+            munmap(sqRing, sqRingSize);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool Init(unsigned entries)
+    {
+        io_uring_params params = {};
+        fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0)
+            return false;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+        bool isSingleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (isSingleMmap)
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED)
+            return false;
+
+        cqRing = isSingleMmap ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+            return false;
+
+        sqes = (io_uring_sqe *)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return false;
+
+        uint8_t *sq = (uint8_t *)sqRing;
+        sqHead = (unsigned *)(sq + params.sq_off.head);
+        sqTail = (unsigned *)(sq + params.sq_off.tail);
+        sqArray = (unsigned *)(sq + params.sq_off.array);
+        sqMask = *(unsigned *)(sq + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        sqLocalTail = *sqTail;
+
+        uint8_t *cq = (uint8_t *)cqRing;
+        cqHead = (unsigned *)(cq + params.cq_off.head);
+        cqTail = (unsigned *)(cq + params.cq_off.tail);
+        cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+        cqMask = *(unsigned *)(cq + params.cq_off.ring_mask);
+
+        return IsSupported(IORING_OP_OPENAT) && IsSupported(IORING_OP_WRITE) && IsSupported(IORING_OP_CLOSE);
+    }
+
+    bool IsSupported(uint8_t op)
+    {
+        std::vector<uint8_t> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+        io_uring_probe *probe = (io_uring_probe *)buffer.data();
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+            return false;
+
+        return op < probe->ops_len && (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+
+    io_uring_sqe *GetSqe()
+    {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (sqLocalTail - head >= sqEntries)
+            return nullptr;
+
+        unsigned index = sqLocalTail & sqMask;
+        sqArray[index] = index;
+        sqLocalTail++;
+        sqQueuedNum++;
+
+        io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+
+        return sqe;
+    }
+
+    // Submits all queued entries, completions are collected by "Wait"
+    bool Submit()
+    {
+        __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+
+        unsigned submitNum = sqQueuedNum;
+        sqQueuedNum = 0;
+
+        while (submitNum)
+        {
+            int result = (int)syscall(__NR_io_uring_enter, fd, submitNum, 0, 0, nullptr, 0);
+            if (result < 0 && errno == EINTR)
+                continue;
+
+            if (result <= 0)
+                return false;
+
+            submitNum -= std::min((unsigned)result, submitNum);
+        }
+
+        return true;
+    }
+
+    bool PopCqe(io_uring_cqe &outCqe)
+    {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+            return false;
+
+        outCqe = cqes[head & cqMask];
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+        return true;
+    }
+
+    // Waits for and collects exactly "num" completions
+    bool Wait(unsigned num, std::vector<io_uring_cqe> &outCqes)
+    {
+        outCqes.clear();
+        while (outCqes.size() < num)
+        {
+            io_uring_cqe cqe;
+            if (PopCqe(cqe))
+            {
+                outCqes.push_back(cqe);
+                continue;
+            }
+
+            if (syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Collects completions which are already available, i.e. after a failed "Wait"
+    void Drain(std::vector<io_uring_cqe> &outCqes)
+    {
+        io_uring_cqe cqe;
+        while (PopCqe(cqe))
+            outCqes.push_back(cqe);
+    }
+};
+
+#else
+
+struct Uring
+{
+};
+
+#endif
+
+// Synchronous fallback, also used to complete anything io_uring couldn't
+bool WriteOutputFile(const std::string &file, const void *data, size_t size, bool isText)
+{
+    FILE *stream = fopen(file.c_str(), isText ? "w" : "wb");
+    if (!stream)
+        return false;
+
+    bool success = size == 0 || fwrite(data, size, 1, stream) == 1;
+    success &= fclose(stream) == 0;
+
+    return success;
+}
+
+// Reads back an output the same way it's written, to hash the same bytes
+static bool HashOutput(const std::string &file, uint64_t fileSize, bool isText, uint64_t &outHash)
+{
+    FILE *stream = fopen(file.c_str(), isText ? "r" : "rb");
+    if (!stream)
+        return false;
+
+    Hasher hasher;
+    std::vector<uint8_t> buffer(std::min<uint64_t>(fileSize + 1, OUTPUT_COMPARE_CHUNK_SIZE));
+    size_t readSize;
+    while ((readSize = fread(buffer.data(), 1, buffer.size(), stream)) != 0)
+        hasher.Update(buffer.data(), readSize);
+
+    bool success = !ferror(stream);
+    fclose(stream);
+
+    outHash = hasher.Finalize();
+
+    return success;
+}
+
+bool IsOutputUnchanged(const std::string &file, uint64_t fileSize, uint64_t hash, bool isText)
+{
+    std::error_code ec;
+    if (std::filesystem::file_size(file, ec) != fileSize || ec)
+        return false;
+
+    uint64_t fileHash = 0;
+
+    return HashOutput(file, fileSize, isText, fileHash) && fileHash == hash;
+}
+
+bool IsOutputUnchanged(const std::string &file, const void *data, size_t size, bool isText)
+{
+    uint64_t fileSize = size;
+#ifdef _WIN32
+    // "\n" is written as "\r\n"
+    if (isText)
+        fileSize += std::count((const char *)data, (const char *)data + size, '\n');
+#endif
+
+    // The new content is hashed only if the sizes match
+    std::error_code ec;
+    if (std::filesystem::file_size(file, ec) != fileSize || ec)
+        return false;
+
+    uint64_t fileHash = 0;
+
+    return HashOutput(file, fileSize, isText, fileHash) && fileHash == HashData(data, size);
+}
+
+FileWriter::FileWriter(bool writeIfChanged)
+    : m_WriteIfChanged(writeIfChanged)
+{
+#if SHADERMAKE_URING
+    std::unique_ptr<Uring> uring = std::make_unique<Uring>();
+    if (uring->Init(FILE_WRITER_BATCH_SIZE * 2))
+        m_Uring = std::move(uring);
+#endif
+
+    m_Writer = std::thread(&FileWriter::WriterThread, this);
+}
+
+FileWriter::~FileWriter()
+{
+    Flush();
+
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Exit = true;
+    }
+
+    m_WakeUp.notify_all();
+    m_Writer.join();
+}
+
+void FileWriter::Write(const std::string &file, std::vector<uint8_t> &&data, bool isText)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Progress.wait(lock, [this]() { return m_PendingBytes < FILE_WRITER_MAX_PENDING_BYTES; });
+
+        m_PendingBytes += data.size();
+
+        Request &request = m_Requests.emplace_back();
+        request.file = file;
+        request.data = std::move(data);
+        request.isText = isText;
+    }
+
+    m_WakeUp.notify_one();
+}
+
+uint32_t FileWriter::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Progress.wait(lock, [this]() { return m_Requests.empty() && !m_IsWriting; });
+
+    uint32_t failedNum = m_FailedNum;
+    m_FailedNum = 0;
+
+    return failedNum;
+}
+
+void FileWriter::WriterThread()
+{
+    std::vector<Request> batch;
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    while (true)
+    {
+        m_WakeUp.wait(lock, [this]() { return m_Exit || !m_Requests.empty(); });
+
+        if (m_Requests.empty())
+            break;
+
+        // Take everything available, up to a batch
+        size_t batchBytes = 0;
+        while (!m_Requests.empty() && batch.size() < FILE_WRITER_BATCH_SIZE)
+        {
+            batchBytes += m_Requests.front().data.size();
+            batch.push_back(std::move(m_Requests.front()));
+            m_Requests.pop_front();
+        }
+
+        m_IsWriting = true;
+        lock.unlock();
+
+        // Outputs identical to what is already on disk are dropped
+        if (m_WriteIfChanged)
+        {
+            auto unchanged = std::remove_if(batch.begin(), batch.end(), [](const Request &request)
+                { return IsOutputUnchanged(request.file, request.data.data(), request.data.size(), request.isText); });
+
+            m_UnchangedNum += (uint32_t)(batch.end() - unchanged);
+            batch.erase(unchanged, batch.end());
+        }
+
+        WriteBatch(batch);
+
+        uint32_t failedNum = 0;
+        for (const Request &request : batch)
+        {
+            if (request.isFailed)
+            {
+                Utils::Printf(RED "ERROR: Can't write file '%s'!\n", request.file.c_str());
+                failedNum++;
+            }
+        }
+
+        batch.clear();
+
+        lock.lock();
+
+        m_FailedNum += failedNum;
+        m_PendingBytes -= batchBytes;
+        m_IsWriting = false;
+
+        m_Progress.notify_all();
+    }
+}
+
+void FileWriter::WriteBatch(std::vector<Request> &batch)
+{
+    if (m_Uring)
+    {
+        WriteBatchUring(batch);
+        return;
+    }
+
+    for (Request &request : batch)
+        request.isFailed = !WriteOutputFile(request.file, request.data.data(), request.data.size(), request.isText);
+}
+
+void FileWriter::WriteBatchUring(std::vector<Request> &batch)
+{
+#if SHADERMAKE_URING
+    Uring &uring = *m_Uring;
+    std::vector<io_uring_cqe> cqes;
+
+    // Pass 1: open all files
+    std::vector<int> fds(batch.size(), -1);
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        io_uring_sqe *sqe = uring.GetSqe();
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uint64_t)batch[i].file.c_str();
+        sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        sqe->len = 0644;
+        sqe->user_data = i;
+    }
+
+    if (!uring.Submit() || !uring.Wait((unsigned)batch.size(), cqes))
+    {
+        // Files which got opened are closed, the fallback opens them again
+        uring.Drain(cqes);
+        for (const io_uring_cqe &cqe : cqes)
+        {
+            if (cqe.res >= 0)
+                close(cqe.res);
+        }
+
+        // The ring is broken, don't use it anymore
+        Utils::Printf(YELLOW "WARNING: io_uring failed, falling back to regular file writes\n");
+        m_Uring.reset();
+        WriteBatch(batch);
+        return;
+    }
+
+    for (const io_uring_cqe &cqe : cqes)
+        fds[cqe.user_data] = cqe.res;
+
+    // Pass 2: write and close, "close" is linked to "write" so it runs after it
+    const uint64_t closeFlag = 1ull << 63;
+    unsigned submittedNum = 0;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        if (fds[i] < 0)
+        {
+            batch[i].isFailed = true;
+            continue;
+        }
+
+        io_uring_sqe *sqe = uring.GetSqe();
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->fd = fds[i];
+        sqe->addr = (uint64_t)batch[i].data.data();
+        sqe->len = (uint32_t)batch[i].data.size();
+        sqe->off = 0;
+        sqe->user_data = i;
+
+        sqe = uring.GetSqe();
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = fds[i];
+        sqe->user_data = i | closeFlag;
+
+        submittedNum += 2;
+    }
+
+    if (!submittedNum)
+        return;
+
+    if (!uring.Submit() || !uring.Wait(submittedNum, cqes))
+    {
+        // Files are closed unless their linked close has completed
+        uring.Drain(cqes);
+        for (const io_uring_cqe &cqe : cqes)
+        {
+            if ((cqe.user_data & closeFlag) && cqe.res != -ECANCELED)
+                fds[cqe.user_data & ~closeFlag] = -1;
+        }
+
+        for (int fd : fds)
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+
+        // Completion state is unknown, redo the batch synchronously
+        Utils::Printf(YELLOW "WARNING: io_uring failed, falling back to regular file writes\n");
+        m_Uring.reset();
+        WriteBatch(batch);
+        return;
+    }
+
+    for (const io_uring_cqe &cqe : cqes)
+    {
+        size_t i = (size_t)(cqe.user_data & ~closeFlag);
+        Request &request = batch[i];
+
+        if (cqe.user_data & closeFlag)
+        {
+            // A failed write cancels the linked close
+            if (cqe.res == -ECANCELED)
+                close(fds[i]);
+        }
+        else if (cqe.res < 0 || (size_t)cqe.res != request.data.size())
+        {
+            // Short or failed writes are completed the regular way
+            request.isFailed = !WriteOutputFile(request.file, request.data.data(), request.data.size(), request.isText);
+        }
+    }
+#else
+    UNUSED(batch);
+#endif
+}
+
+} // namespace ShaderMake
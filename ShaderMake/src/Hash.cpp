@@ -0,0 +1,418 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "Hash.h"
+
+#include <cstring>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#   define CRC32C_HARDWARE
+#   include <nmmintrin.h>
+#   ifdef _MSC_VER
+#       include <intrin.h>
+#       define TARGET_SSE42
+#   else
+#       define TARGET_SSE42 __attribute__((target("sse4.2")))
+#   endif
+#endif
+
+// CRC32C polynomial, reflected
+#define CRC32C_POLY 0x82f63b78
+
+// Block sizes of the hardware path: 3 blocks are processed in parallel to hide the latency of "crc32", then combined
+#define CRC32C_LONG 8192
+#define CRC32C_SHORT 256
+#define CRC32C_TINY 32
+
+namespace ShaderMake
+{
+
+static const uint64_t g_Prime1 = 11400714785074694791ull;
+static const uint64_t g_Prime2 = 14029467366897019727ull;
+static const uint64_t g_Prime3 = 1609587929392839161ull;
+static const uint64_t g_Prime4 = 9650029242287828579ull;
+static const uint64_t g_Prime5 = 2870177450012600261ull;
+
+static inline uint64_t RotateLeft(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t Read64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t Read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+    acc += input * g_Prime2;
+    acc = RotateLeft(acc, 31);
+    return acc * g_Prime1;
+}
+
+static inline uint64_t MergeRound(uint64_t acc, uint64_t value)
+{
+    acc ^= Round(0, value);
+    return acc * g_Prime1 + g_Prime4;
+}
+
+Hasher::Hasher(uint64_t seed)
+    : m_Seed(seed)
+{
+    m_Acc[0] = seed + g_Prime1 + g_Prime2;
+    m_Acc[1] = seed + g_Prime2;
+    m_Acc[2] = seed;
+    m_Acc[3] = seed - g_Prime1;
+}
+
+void Hasher::Update(const void *data, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    const uint8_t *end = p + size;
+
+    m_TotalSize += size;
+
+    // Top up a partially filled stripe first
+    if (m_BufferSize + size < sizeof(m_Buffer))
+    {
+        if (size)
+            memcpy(m_Buffer + m_BufferSize, p, size);
+        m_BufferSize += (uint32_t)size;
+        return;
+    }
+
+    if (m_BufferSize)
+    {
+        size_t fill = sizeof(m_Buffer) - m_BufferSize;
+        memcpy(m_Buffer + m_BufferSize, p, fill);
+        p += fill;
+
+        m_Acc[0] = Round(m_Acc[0], Read64(m_Buffer + 0));
+        m_Acc[1] = Round(m_Acc[1], Read64(m_Buffer + 8));
+        m_Acc[2] = Round(m_Acc[2], Read64(m_Buffer + 16));
+        m_Acc[3] = Round(m_Acc[3], Read64(m_Buffer + 24));
+        m_BufferSize = 0;
+    }
+
+    while (p + 32 <= end)
+    {
+        m_Acc[0] = Round(m_Acc[0], Read64(p + 0));
+        m_Acc[1] = Round(m_Acc[1], Read64(p + 8));
+        m_Acc[2] = Round(m_Acc[2], Read64(p + 16));
+        m_Acc[3] = Round(m_Acc[3], Read64(p + 24));
+        p += 32;
+    }
+
+    if (p < end)
+    {
+        m_BufferSize = (uint32_t)(end - p);
+        memcpy(m_Buffer, p, m_BufferSize);
+    }
+}
+
+void Hasher::Update(const std::string &s)
+{
+    // Length is hashed too, so that a sequence of strings can't alias a different split of the same bytes
+    Update((uint64_t)s.size());
+    Update(s.data(), s.size());
+}
+
+uint64_t Hasher::Finalize() const
+{
+    uint64_t h;
+    if (m_TotalSize >= 32)
+    {
+        h = RotateLeft(m_Acc[0], 1) + RotateLeft(m_Acc[1], 7) + RotateLeft(m_Acc[2], 12) + RotateLeft(m_Acc[3], 18);
+        h = MergeRound(h, m_Acc[0]);
+        h = MergeRound(h, m_Acc[1]);
+        h = MergeRound(h, m_Acc[2]);
+        h = MergeRound(h, m_Acc[3]);
+    }
+    else
+        h = m_Seed + g_Prime5;
+
+    h += m_TotalSize;
+
+    const uint8_t *p = m_Buffer;
+    const uint8_t *end = m_Buffer + m_BufferSize;
+
+    while (p + 8 <= end)
+    {
+        h ^= Round(0, Read64(p));
+        h = RotateLeft(h, 27) * g_Prime1 + g_Prime4;
+        p += 8;
+    }
+
+    if (p + 4 <= end)
+    {
+        h ^= (uint64_t)Read32(p) * g_Prime1;
+        h = RotateLeft(h, 23) * g_Prime2 + g_Prime3;
+        p += 4;
+    }
+
+    while (p < end)
+    {
+        h ^= (*p) * g_Prime5;
+        h = RotateLeft(h, 11) * g_Prime1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= g_Prime2;
+    h ^= h >> 29;
+    h *= g_Prime3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+uint64_t HashData(const void *data, size_t size, uint64_t seed)
+{
+    Hasher hasher(seed);
+    hasher.Update(data, size);
+    return hasher.Finalize();
+}
+
+std::string HashToString(uint64_t hash)
+{
+    char buf[20];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)hash);
+    return buf;
+}
+
+//==================================================================================================================================
+// CRC32C
+//==================================================================================================================================
+
+// Multiplies a vector by a 32x32 matrix over GF(2)
+static uint32_t Gf2MatrixTimes(const uint32_t *matrix, uint32_t vector)
+{
+    uint32_t sum = 0;
+    for (; vector; vector >>= 1, matrix++)
+    {
+        if (vector & 1)
+            sum ^= *matrix;
+    }
+
+    return sum;
+}
+
+static void Gf2MatrixSquare(uint32_t *square, const uint32_t *matrix)
+{
+    for (uint32_t n = 0; n < 32; n++)
+        square[n] = Gf2MatrixTimes(matrix, matrix[n]);
+}
+
+struct Crc32cTables
+{
+    uint32_t slices[8][256]; // slicing-by-8
+    uint32_t longShift[4][256]; // appends CRC32C_LONG zero bytes to a CRC
+    uint32_t shortShift[4][256]; // appends CRC32C_SHORT zero bytes to a CRC
+    uint32_t tinyShift[4][256]; // appends CRC32C_TINY zero bytes to a CRC
+    bool hasHardware = false;
+
+    Crc32cTables()
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t crc = n;
+            for (uint32_t k = 0; k < 8; k++)
+                crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+
+            slices[0][n] = crc;
+        }
+
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            for (uint32_t k = 1; k < 8; k++)
+                slices[k][n] = (slices[k - 1][n] >> 8) ^ slices[0][slices[k - 1][n] & 0xFF];
+        }
+
+        BuildShift(longShift, CRC32C_LONG);
+        BuildShift(shortShift, CRC32C_SHORT);
+        BuildShift(tinyShift, CRC32C_TINY);
+
+#ifdef CRC32C_HARDWARE
+#   ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        hasHardware = (info[2] & (1 << 20)) != 0;
+#   else
+        hasHardware = __builtin_cpu_supports("sse4.2");
+#   endif
+#endif
+    }
+
+    // Operator appending "size" zero bytes, built by repeated squaring of the one zero bit operator
+    static void BuildShift(uint32_t table[4][256], size_t size)
+    {
+        uint32_t odd[32];
+        uint32_t even[32];
+
+        odd[0] = CRC32C_POLY;
+        for (uint32_t n = 1; n < 32; n++)
+            odd[n] = 1u << (n - 1);
+
+        Gf2MatrixSquare(even, odd); // 2 zero bits
+        Gf2MatrixSquare(odd, even); // 4 zero bits
+
+        // "odd" ends up with the operator for "size" zero bytes
+        const uint32_t *op = odd;
+        while (true)
+        {
+            Gf2MatrixSquare(even, odd);
+            size >>= 1;
+            if (!size)
+            {
+                op = even;
+                break;
+            }
+
+            Gf2MatrixSquare(odd, even);
+            size >>= 1;
+            if (!size)
+                break;
+        }
+
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            table[0][n] = Gf2MatrixTimes(op, n);
+            table[1][n] = Gf2MatrixTimes(op, n << 8);
+            table[2][n] = Gf2MatrixTimes(op, n << 16);
+            table[3][n] = Gf2MatrixTimes(op, n << 24);
+        }
+    }
+};
+
+static const Crc32cTables &GetCrc32cTables()
+{
+    static const Crc32cTables tables;
+
+    return tables;
+}
+
+static inline uint32_t Crc32cShift(const uint32_t table[4][256], uint32_t crc)
+{
+    return table[0][crc & 0xFF] ^ table[1][(crc >> 8) & 0xFF] ^ table[2][(crc >> 16) & 0xFF] ^ table[3][crc >> 24];
+}
+
+static uint32_t Crc32cSoftware(const Crc32cTables &tables, const uint8_t *p, size_t size, uint32_t crc)
+{
+    while (size && ((uintptr_t)p & 7))
+    {
+        crc = tables.slices[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        size--;
+    }
+
+    for (; size >= 8; p += 8, size -= 8)
+    {
+        uint64_t word = crc ^ Read64(p);
+        crc = tables.slices[7][word & 0xFF] ^ tables.slices[6][(word >> 8) & 0xFF]
+            ^ tables.slices[5][(word >> 16) & 0xFF] ^ tables.slices[4][(word >> 24) & 0xFF]
+            ^ tables.slices[3][(word >> 32) & 0xFF] ^ tables.slices[2][(word >> 40) & 0xFF]
+            ^ tables.slices[1][(word >> 48) & 0xFF] ^ tables.slices[0][word >> 56];
+    }
+
+    while (size--)
+        crc = tables.slices[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+#ifdef CRC32C_HARDWARE
+
+// Processes 3 blocks of "blockSize" in parallel
+TARGET_SSE42 static inline uint32_t Crc32cHardwareBlocks(const uint32_t shift[4][256], size_t blockSize, const uint8_t *&p, size_t &size, uint32_t crc)
+{
+    while (size >= blockSize * 3)
+    {
+        uint64_t crc0 = crc;
+        uint64_t crc1 = 0;
+        uint64_t crc2 = 0;
+
+        const uint8_t *end = p + blockSize;
+        for (; p < end; p += 8)
+        {
+            crc0 = _mm_crc32_u64(crc0, Read64(p));
+            crc1 = _mm_crc32_u64(crc1, Read64(p + blockSize));
+            crc2 = _mm_crc32_u64(crc2, Read64(p + blockSize * 2));
+        }
+
+        crc = Crc32cShift(shift, (uint32_t)crc0) ^ (uint32_t)crc1;
+        crc = Crc32cShift(shift, crc) ^ (uint32_t)crc2;
+
+        p += blockSize * 2;
+        size -= blockSize * 3;
+    }
+
+    return crc;
+}
+
+TARGET_SSE42 static uint32_t Crc32cHardware(const Crc32cTables &tables, const uint8_t *p, size_t size, uint32_t crc)
+{
+    while (size && ((uintptr_t)p & 7))
+    {
+        crc = _mm_crc32_u8(crc, *p++);
+        size--;
+    }
+
+    crc = Crc32cHardwareBlocks(tables.longShift, CRC32C_LONG, p, size, crc);
+    crc = Crc32cHardwareBlocks(tables.shortShift, CRC32C_SHORT, p, size, crc);
+    crc = Crc32cHardwareBlocks(tables.tinyShift, CRC32C_TINY, p, size, crc);
+
+    uint64_t crc64 = crc;
+    for (; size >= 8; p += 8, size -= 8)
+        crc64 = _mm_crc32_u64(crc64, Read64(p));
+
+    crc = (uint32_t)crc64;
+    while (size--)
+        crc = _mm_crc32_u8(crc, *p++);
+
+    return crc;
+}
+
+#endif
+
+uint32_t Crc32c(const void *data, size_t size, uint32_t crc)
+{
+    const Crc32cTables &tables = GetCrc32cTables();
+    const uint8_t *p = (const uint8_t *)data;
+
+#ifdef CRC32C_HARDWARE
+    if (tables.hasHardware)
+        return ~Crc32cHardware(tables, p, size, ~crc);
+#endif
+
+    return ~Crc32cSoftware(tables, p, size, ~crc);
+}
+
+} // namespace ShaderMake
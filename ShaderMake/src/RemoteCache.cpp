@@ -0,0 +1,459 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifdef _WIN32
+#   include <winsock2.h>
+#   include <ws2tcpip.h>
+#else
+#   include <sys/types.h>
+#   include <sys/socket.h>
+#   include <sys/time.h>
+#   include <netdb.h>
+#   include <poll.h>
+#   include <fcntl.h>
+#   include <errno.h>
+#endif
+
+#include "Cache.h"
+#include "Context.h"
+
+#include <sstream>
+#include <cstring>
+
+namespace ShaderMake {
+
+#ifdef _WIN32
+typedef SOCKET Socket;
+#   define INVALID_SOCKET_HANDLE INVALID_SOCKET
+#   define CloseSocket closesocket
+#   define SEND_FLAGS 0
+#else
+typedef int Socket;
+#   define INVALID_SOCKET_HANDLE (-1)
+#   define CloseSocket close
+#   define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+// Objects larger than that are neither uploaded nor accepted
+#define REMOTE_CACHE_MAX_OBJECT_SIZE (256 << 20)
+
+// Uploads are dropped when the queue grows above that, the build must never wait for the network
+#define REMOTE_CACHE_MAX_PENDING_BYTES (512 << 20)
+
+// Lookups in flight at the same time, they mostly wait for the network
+#define REMOTE_CACHE_LOOKUP_THREADS 16
+
+static Socket ConnectWithTimeout(const std::string &host, const std::string &port, uint32_t timeoutMs)
+{
+#ifdef _WIN32
+    static bool isInitialized = false;
+    static std::mutex initMutex;
+    {
+        std::lock_guard<std::mutex> guard(initMutex);
+        if (!isInitialized)
+        {
+            WSADATA wsaData;
+            if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+                return INVALID_SOCKET_HANDLE;
+            isInitialized = true;
+        }
+    }
+#endif
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+        return INVALID_SOCKET_HANDLE;
+
+    Socket result = INVALID_SOCKET_HANDLE;
+    for (addrinfo *address = addresses; address && result == INVALID_SOCKET_HANDLE; address = address->ai_next)
+    {
+        Socket s = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (s == INVALID_SOCKET_HANDLE)
+            continue;
+
+        // Non-blocking connect, to be able to time out
+#ifdef _WIN32
+        u_long mode = 1;
+        ioctlsocket(s, FIONBIO, &mode);
+#else
+        int flags = fcntl(s, F_GETFL, 0);
+        fcntl(s, F_SETFL, flags | O_NONBLOCK);
+#endif
+
+        bool isConnected = connect(s, address->ai_addr, (int)address->ai_addrlen) == 0;
+        if (!isConnected)
+        {
+#ifdef _WIN32
+            bool isPending = WSAGetLastError() == WSAEWOULDBLOCK;
+            WSAPOLLFD pfd = { s, POLLOUT, 0 };
+            isPending = isPending && WSAPoll(&pfd, 1, (int)timeoutMs) == 1;
+#else
+            bool isPending = errno == EINPROGRESS;
+            pollfd pfd = { s, POLLOUT, 0 };
+            isPending = isPending && poll(&pfd, 1, (int)timeoutMs) == 1;
+#endif
+            if (isPending)
+            {
+                int error = 0;
+                socklen_t len = sizeof(error);
+                getsockopt(s, SOL_SOCKET, SO_ERROR, (char *)&error, &len);
+                isConnected = error == 0;
+            }
+        }
+
+        if (!isConnected)
+        {
+            CloseSocket(s);
+            continue;
+        }
+
+        // Back to blocking mode with send/receive timeouts
+#ifdef _WIN32
+        mode = 0;
+        ioctlsocket(s, FIONBIO, &mode);
+
+        DWORD timeout = timeoutMs;
+#else
+        fcntl(s, F_SETFL, flags);
+
+        timeval timeout = {};
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_usec = (timeoutMs % 1000) * 1000;
+#endif
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+        setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+
+        result = s;
+    }
+
+    freeaddrinfo(addresses);
+
+    return result;
+}
+
+static bool SendAll(Socket s, const void *data, size_t size)
+{
+    const char *p = (const char *)data;
+    while (size)
+    {
+        int sent = send(s, p, (int)std::min(size, size_t(1 << 20)), SEND_FLAGS);
+        if (sent <= 0)
+            return false;
+
+        p += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+RemoteCache::RemoteCache(const std::string &url, bool isReadOnly, uint32_t timeoutMs)
+    : m_Url(url), m_TimeoutMs(timeoutMs), m_IsReadOnly(isReadOnly)
+{
+    // Only plain "http://host[:port][/path]" is supported
+    const char *scheme = "http://";
+    if (url.compare(0, strlen(scheme), scheme) != 0)
+    {
+        Utils::Printf(RED "ERROR: Remote cache URL '%s' must start with '%s'!\n", url.c_str(), scheme);
+        return;
+    }
+
+    std::string authority = url.substr(strlen(scheme));
+    size_t slash = authority.find('/');
+    if (slash != std::string::npos)
+    {
+        m_PathPrefix = authority.substr(slash);
+        authority.resize(slash);
+    }
+
+    if (m_PathPrefix.empty() || m_PathPrefix.back() != '/')
+        m_PathPrefix += '/';
+
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos)
+    {
+        m_Port = authority.substr(colon + 1);
+        authority.resize(colon);
+    }
+
+    // IPv6 literals come in brackets
+    if (authority.size() > 2 && authority.front() == '[' && authority.back() == ']')
+        authority = authority.substr(1, authority.size() - 2);
+
+    m_Host = authority;
+
+    if (!IsValid())
+        return;
+
+    for (uint32_t i = 0; i < REMOTE_CACHE_LOOKUP_THREADS; i++)
+        m_Lookupers.push_back(std::thread(&RemoteCache::LookupThread, this));
+
+    if (!m_IsReadOnly)
+        m_Uploader = std::thread(&RemoteCache::UploadThread, this);
+}
+
+RemoteCache::~RemoteCache()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Exit = true;
+    }
+
+    m_WakeUp.notify_all();
+    m_LookupWakeUp.notify_all();
+
+    for (std::thread &lookuper : m_Lookupers)
+        lookuper.join();
+
+    if (m_Uploader.joinable())
+        m_Uploader.join();
+}
+
+bool RemoteLookup::Wait(std::vector<uint8_t> &outData)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Done.wait(lock, [this]() { return m_IsDone; });
+
+    if (m_IsHit)
+        outData = std::move(m_Data);
+
+    return m_IsHit;
+}
+
+void RemoteCache::Disable(const char *reason)
+{
+    if (m_IsAvailable.exchange(false))
+        Utils::Printf(YELLOW "WARNING: Remote cache '%s' %s, continuing without it\n", m_Url.c_str(), reason);
+}
+
+bool RemoteCache::Request(const char *method, const std::string &key, const void *body, size_t bodySize, int &outStatus, std::vector<uint8_t> *outBody)
+{
+    outStatus = 0;
+
+    Socket s = ConnectWithTimeout(m_Host, m_Port, m_TimeoutMs);
+    if (s == INVALID_SOCKET_HANDLE)
+        return false;
+
+    std::ostringstream header;
+    header << method << " " << m_PathPrefix << key << " HTTP/1.1\r\n";
+    header << "Host: " << m_Host << "\r\n";
+    header << "Connection: close\r\n";
+    if (body)
+    {
+        header << "Content-Type: application/octet-stream\r\n";
+        header << "Content-Length: " << bodySize << "\r\n";
+    }
+    header << "\r\n";
+
+    std::string headerString = header.str();
+    bool success = SendAll(s, headerString.data(), headerString.size());
+    if (success && body)
+        success = SendAll(s, body, bodySize);
+
+    // The server closes the connection after the response
+    std::vector<uint8_t> response;
+    if (success)
+    {
+        char buf[64 << 10];
+        while (true)
+        {
+            int received = recv(s, buf, sizeof(buf), 0);
+            if (received == 0)
+                break;
+
+            if (received < 0 || response.size() + received > REMOTE_CACHE_MAX_OBJECT_SIZE)
+            {
+                success = false;
+                break;
+            }
+
+            response.insert(response.end(), buf, buf + received);
+        }
+    }
+
+    CloseSocket(s);
+
+    if (!success)
+        return false;
+
+    // Status line: "HTTP/1.x NNN ..."
+    const char *headerEnd = "\r\n\r\n";
+    auto bodyStart = std::search(response.begin(), response.end(), headerEnd, headerEnd + 4);
+    if (bodyStart == response.end() || response.size() < 12 || memcmp(response.data(), "HTTP/1.", 7) != 0)
+        return false;
+
+    std::string responseHeader(response.begin(), bodyStart);
+    outStatus = atoi(responseHeader.c_str() + 9);
+
+    if (outBody)
+    {
+        outBody->assign(bodyStart + 4, response.end());
+
+        // A truncated body is a transport error
+        std::string lowerCaseHeader = responseHeader;
+        std::transform(lowerCaseHeader.begin(), lowerCaseHeader.end(), lowerCaseHeader.begin(), [](char ch) { return (char)tolower(ch); });
+
+        size_t contentLength = lowerCaseHeader.find("content-length:");
+        if (contentLength != std::string::npos && strtoull(lowerCaseHeader.c_str() + contentLength + 15, nullptr, 10) != outBody->size())
+            return false;
+    }
+
+    return true;
+}
+
+std::shared_ptr<RemoteLookup> RemoteCache::Lookup(const std::string &key)
+{
+    if (!IsAvailable())
+        return nullptr;
+
+    std::shared_ptr<RemoteLookup> lookup = std::make_shared<RemoteLookup>();
+    lookup->m_Key = key;
+
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        m_Lookups.push_back(lookup);
+    }
+
+    m_LookupWakeUp.notify_one();
+
+    return lookup;
+}
+
+bool RemoteCache::Get(const std::string &key, std::vector<uint8_t> &outData)
+{
+    std::shared_ptr<RemoteLookup> lookup = Lookup(key);
+
+    return lookup && lookup->Wait(outData);
+}
+
+void RemoteCache::Put(const std::string &key, const void *data, size_t size)
+{
+    if (m_IsReadOnly || !IsValid() || !m_IsAvailable || size > REMOTE_CACHE_MAX_OBJECT_SIZE)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(m_Mutex);
+        if (m_PendingBytes + size > REMOTE_CACHE_MAX_PENDING_BYTES)
+            return;
+
+        Upload &upload = m_Uploads.emplace_back();
+        upload.key = key;
+        upload.data.assign((const uint8_t *)data, (const uint8_t *)data + size);
+
+        m_PendingBytes += size;
+    }
+
+    m_WakeUp.notify_one();
+}
+
+void RemoteCache::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Idle.wait(lock, [this]() { return m_Uploads.empty() && !m_IsUploading; });
+}
+
+void RemoteCache::LookupThread()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    while (true)
+    {
+        m_LookupWakeUp.wait(lock, [this]() { return m_Exit || !m_Lookups.empty(); });
+
+        if (m_Lookups.empty())
+            break;
+
+        std::shared_ptr<RemoteLookup> lookup = std::move(m_Lookups.front());
+        m_Lookups.pop_front();
+        bool isExiting = m_Exit;
+
+        lock.unlock();
+
+        // The tier may have been disabled while the lookup was queued, lookups still queued on exit are misses
+        std::vector<uint8_t> data;
+        int status = 0;
+        bool isHit = false;
+        if (m_IsAvailable && !isExiting)
+        {
+            if (!Request("GET", lookup->m_Key, nullptr, 0, status, &data))
+                Disable("is not reachable");
+            else
+                isHit = status == 200 && !data.empty();
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lookup->m_Mutex);
+            lookup->m_Data = std::move(data);
+            lookup->m_IsHit = isHit;
+            lookup->m_IsDone = true;
+        }
+
+        lookup->m_Done.notify_all();
+
+        lock.lock();
+    }
+}
+
+void RemoteCache::UploadThread()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    while (true)
+    {
+        m_WakeUp.wait(lock, [this]() { return m_Exit || !m_Uploads.empty(); });
+
+        if (m_Uploads.empty())
+            break;
+
+        Upload upload = std::move(m_Uploads.front());
+        m_Uploads.pop_front();
+        m_IsUploading = true;
+
+        lock.unlock();
+
+        if (m_IsAvailable)
+        {
+            int status = 0;
+            if (!Request("PUT", upload.key, upload.data.data(), upload.data.size(), status, nullptr))
+                Disable("is not reachable");
+            else if (status == 403 || status == 405)
+                Disable("does not accept uploads");
+        }
+
+        lock.lock();
+
+        m_PendingBytes -= upload.data.size();
+        m_IsUploading = false;
+
+        if (m_Uploads.empty())
+            m_Idle.notify_all();
+    }
+
+    m_IsUploading = false;
+    m_Idle.notify_all();
+}
+
+} // namespace ShaderMake
@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include "ShaderArchive.h"
+
+namespace ShaderMake {
+
+std::string MakeArchiveKey(const std::string &shaderName, const std::string &permutationKey)
+{
+    return shaderName + ":" + permutationKey;
+}
+
+bool ShaderArchive::Open(const std::filesystem::path &file)
+{
+    Close();
+
+    if (!m_File.Open(file))
+        return false;
+
+    if (!Open(m_File.GetData(), m_File.GetSize()))
+    {
+        m_File.Close();
+        return false;
+    }
+
+    return true;
+}
+
+bool ShaderArchive::Open(const void *data, size_t size)
+{
+    const ShaderBlobTocEntry *toc = nullptr;
+    uint32_t entryNum = 0;
+    if (!GetBlobTableOfContents(data, size, &toc, &entryNum))
+        return false;
+
+    m_Data = (const uint8_t *)data;
+    m_Toc = toc;
+    m_EntryNum = entryNum;
+
+    return true;
+}
+
+void ShaderArchive::Close()
+{
+    m_File.Close();
+
+    m_Data = nullptr;
+    m_Toc = nullptr;
+    m_EntryNum = 0;
+}
+
+std::string_view ShaderArchive::GetKey(uint32_t index) const
+{
+    return index < m_EntryNum ? GetKey(m_Toc[index]) : std::string_view();
+}
+
+bool ShaderArchive::Find(std::string_view key, const void **pBinary, size_t *pSize) const
+{
+    return Find(key, HashPermutationKey(key.data(), key.size()), pBinary, pSize);
+}
+
+bool ShaderArchive::Find(const PermutationKey &key, const void **pBinary, size_t *pSize) const
+{
+    return Find(key.GetString(), key.GetHash(), pBinary, pSize);
+}
+
+bool ShaderArchive::Find(std::string_view key, uint64_t keyHash, const void **pBinary, size_t *pSize) const
+{
+    const ShaderBlobTocEntry *entry = FindInBlobTableOfContents(m_Data, m_Toc, m_EntryNum, key.data(), key.size(), keyHash);
+    if (!entry || (entry->flags & ShaderBlobFlag_Compressed))
+        return false;
+
+    *pBinary = m_Data + entry->dataOffset;
+    *pSize = entry->dataSize;
+
+    return true;
+}
+
+bool ShaderArchive::Find(const char *shaderName, const ShaderConstant *constants, uint32_t numConstants, const void **pBinary, size_t *pSize) const
+{
+    return Find(MakeArchiveKey(shaderName, MakePermutationKey(constants, numConstants)), pBinary, pSize);
+}
+
+} // namespace ShaderMake
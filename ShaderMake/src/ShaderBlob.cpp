@@ -21,6 +21,8 @@ THE SOFTWARE.
 */
 
 #include "ShaderBlob.h"
+#include "Compression.h"
+#include "Hash.h"
 
 #include <sstream>
 #include <cstring>
@@ -31,32 +33,138 @@ namespace ShaderMake
 {
 
 static const char* g_BlobSignature = "NVSP";
+static const char* g_BlobSignatureV2 = "NVS2";
 static size_t g_BlobSignatureSize = 4;
+static const uint32_t g_BlobVersionV2 = 3;
 
-bool FindPermutationInBlob(const void* blob, size_t blobSize, const ShaderConstant* constants, uint32_t numConstants, const void** pBinary, size_t* pSize)
+struct BlobV2
 {
-    if (!blob || blobSize < g_BlobSignatureSize)
+    const uint8_t* data;
+    size_t size;
+    ShaderBlobFooter footer;
+};
+
+static bool ParseBlobV2(const void* blob, size_t blobSize, BlobV2& out)
+{
+    if (!blob || blobSize < g_BlobSignatureSize + sizeof(ShaderBlobFooter) || memcmp(blob, g_BlobSignatureV2, g_BlobSignatureSize) != 0)
         return false;
 
-    if (!pBinary || !pSize)
+    out.data = static_cast<const uint8_t*>(blob);
+    out.size = blobSize;
+    memcpy(&out.footer, out.data + blobSize - sizeof(ShaderBlobFooter), sizeof(ShaderBlobFooter));
+
+    const ShaderBlobFooter& footer = out.footer;
+    if (memcmp(footer.signature, g_BlobSignatureV2, g_BlobSignatureSize) != 0 || footer.version != g_BlobVersionV2)
         return false;
 
-    if (memcmp(blob, g_BlobSignature, g_BlobSignatureSize) != 0)
+    uint64_t tocEnd = blobSize - sizeof(ShaderBlobFooter);
+    if (footer.tocOffset > tocEnd || (tocEnd - footer.tocOffset) / sizeof(ShaderBlobTocEntry) < footer.entryCount)
+        return false;
+
+    if (footer.indexOffset > tocEnd || (tocEnd - footer.indexOffset) / sizeof(uint32_t) < footer.indexSize)
+        return false;
+
+    // The dimension descriptor sits between the table of contents and the index table
+    if ((footer.flags & ShaderBlobFooterFlag_Dimensions) && footer.tocOffset + (uint64_t)footer.entryCount * sizeof(ShaderBlobTocEntry) > footer.indexOffset)
+        return false;
+
+    // The checksum table follows the index table
+    uint64_t checksumOffset = footer.indexOffset + (uint64_t)footer.indexSize * sizeof(uint32_t);
+    if ((footer.flags & ShaderBlobFooterFlag_Checksums) && (tocEnd - checksumOffset) / sizeof(uint32_t) < footer.entryCount)
+        return false;
+
+    return footer.dictionaryOffset <= tocEnd && footer.dictionarySize <= tocEnd - footer.dictionaryOffset;
+}
+
+// The blob may be unaligned, entries are copied out
+static ShaderBlobTocEntry GetTocEntry(const BlobV2& blob, uint32_t index)
+{
+    ShaderBlobTocEntry entry;
+    memcpy(&entry, blob.data + blob.footer.tocOffset + index * sizeof(ShaderBlobTocEntry), sizeof(entry));
+
+    return entry;
+}
+
+// Uncompressed payloads are handed out as "dataSize" bytes in place, so "dataSize" must match the bounded "storedSize"
+static bool IsTocEntryValid(const BlobV2& blob, const ShaderBlobTocEntry& entry)
+{
+    return entry.keyOffset <= blob.size && entry.keySize <= blob.size - entry.keyOffset
+        && entry.dataOffset <= blob.size && entry.storedSize <= blob.size - entry.dataOffset
+        && ((entry.flags & ShaderBlobFlag_Compressed) || entry.dataSize == entry.storedSize);
+}
+
+// Payloads are not verified if the blob has no checksums
+static bool IsChecksumValid(const BlobV2& blob, uint32_t entryIndex, const ShaderBlobTocEntry& entry)
+{
+    if (!(blob.footer.flags & ShaderBlobFooterFlag_Checksums))
+        return true;
+
+    uint32_t checksum;
+    uint64_t checksumOffset = blob.footer.indexOffset + ((uint64_t)blob.footer.indexSize + entryIndex) * sizeof(uint32_t);
+    memcpy(&checksum, blob.data + checksumOffset, sizeof(checksum));
+
+    return Crc32c(blob.data + entry.dataOffset, entry.storedSize) == checksum;
+}
+
+static bool FindTocEntryByIndex(const BlobV2& blob, uint32_t index, ShaderBlobTocEntry& outEntry, uint32_t& outEntryIndex)
+{
+    if (index >= blob.footer.indexSize)
+        return false;
+
+    uint32_t entryIndex;
+    memcpy(&entryIndex, blob.data + blob.footer.indexOffset + index * sizeof(uint32_t), sizeof(entryIndex));
+    if (entryIndex >= blob.footer.entryCount)
+        return false; // no permutation with this index
+
+    outEntry = GetTocEntry(blob, entryIndex);
+    outEntryIndex = entryIndex;
+
+    return IsTocEntryValid(blob, outEntry);
+}
+
+static bool FindTocEntry(const BlobV2& blob, const PermutationKey& key, ShaderBlobTocEntry& outEntry, uint32_t& outEntryIndex)
+{
+    const std::string& permutation = key.GetString();
+    uint64_t keyHash = key.GetHash();
+
+    // The first entry with this hash
+    uint32_t first = 0;
+    uint32_t count = blob.footer.entryCount;
+    while (count > 0)
     {
-        if (numConstants == 0)
+        uint32_t step = count / 2;
+        if (GetTocEntry(blob, first + step).keyHash < keyHash)
         {
-            *pBinary = blob;
-            *pSize = blobSize;
-
-            return true; // this blob is not a permutation blob, and no permutation is requested
+            first += step + 1;
+            count -= step + 1;
         }
         else
-            return false; // this blob is not a permutation blob, but the caller requested a permutation
+            count = step;
     }
 
-    blob = static_cast<const char*>(blob) + g_BlobSignatureSize;
-    blobSize -= g_BlobSignatureSize;
+    // Colliding hashes are told apart by keys
+    for (uint32_t i = first; i < blob.footer.entryCount; i++)
+    {
+        ShaderBlobTocEntry entry = GetTocEntry(blob, i);
+        if (entry.keyHash != keyHash)
+            break;
+
+        if (!IsTocEntryValid(blob, entry))
+            return false; // the blob is corrupted
+
+        if (entry.keySize == permutation.size() && memcmp(blob.data + entry.keyOffset, permutation.data(), permutation.size()) == 0)
+        {
+            outEntry = entry;
+            outEntryIndex = i;
+            return true;
+        }
+    }
+
+    return false;
+}
 
+std::string MakePermutationKey(const ShaderConstant* constants, uint32_t numConstants)
+{
     // Making a vector of constant names to sort them
     std::vector<std::string> constantNames((size_t)numConstants);
     for (uint32_t n = 0; n < numConstants; n++)
@@ -76,7 +184,60 @@ bool FindPermutationInBlob(const void* blob, size_t blobSize, const ShaderConsta
         if (n + 1 < numConstants)
             ss << " ";
     }
-    std::string permutation = ss.str();
+
+    return ss.str();
+}
+
+uint64_t HashPermutationKey(const char* key, size_t keySize)
+{
+    return HashData(key, keySize);
+}
+
+bool FindPermutationInBlob(const void* blob, size_t blobSize, const ShaderConstant* constants, uint32_t numConstants, const void** pBinary, size_t* pSize)
+{
+    return FindPermutationInBlob(blob, blobSize, PermutationKey(constants, numConstants), pBinary, pSize);
+}
+
+bool FindPermutationInBlob(const void* blob, size_t blobSize, const PermutationKey& key, const void** pBinary, size_t* pSize)
+{
+    if (!blob || blobSize < g_BlobSignatureSize)
+        return false;
+
+    if (!pBinary || !pSize)
+        return false;
+
+    // Compressed v2 permutations can only be read through "ReadPermutationFromBlob"
+    BlobV2 blobV2;
+    if (ParseBlobV2(blob, blobSize, blobV2))
+    {
+        ShaderBlobTocEntry entry;
+        uint32_t entryIndex;
+        if (!FindTocEntry(blobV2, key, entry, entryIndex) || (entry.flags & ShaderBlobFlag_Compressed))
+            return false;
+
+        *pBinary = blobV2.data + entry.dataOffset;
+        *pSize = entry.dataSize;
+
+        return true;
+    }
+
+    if (memcmp(blob, g_BlobSignature, g_BlobSignatureSize) != 0)
+    {
+        if (key.IsEmpty())
+        {
+            *pBinary = blob;
+            *pSize = blobSize;
+
+            return true; // this blob is not a permutation blob, and no permutation is requested
+        }
+        else
+            return false; // this blob is not a permutation blob, but the caller requested a permutation
+    }
+
+    blob = static_cast<const char*>(blob) + g_BlobSignatureSize;
+    blobSize -= g_BlobSignatureSize;
+
+    const std::string& permutation = key.GetString();
 
     while (blobSize > sizeof(ShaderBlobEntry))
     {
@@ -108,8 +269,161 @@ bool FindPermutationInBlob(const void* blob, size_t blobSize, const ShaderConsta
     return false; // went through the blob, permutation not found
 }
 
+uint32_t FindPermutationsInBlob(const void* blob, size_t blobSize, const PermutationKey* keys, uint32_t keyNum, const void** pBinaries, size_t* pSizes)
+{
+    if (!pBinaries || !pSizes || (keyNum && !keys))
+        return 0;
+
+    for (uint32_t i = 0; i < keyNum; i++)
+    {
+        pBinaries[i] = nullptr;
+        pSizes[i] = 0;
+    }
+
+    if (!blob || blobSize < g_BlobSignatureSize)
+        return 0;
+
+    // Keys in hash order (hash, key index), so both formats are processed in one pass
+    std::vector<std::pair<uint64_t, uint32_t>> order(keyNum);
+    for (uint32_t i = 0; i < keyNum; i++)
+        order[i] = {keys[i].GetHash(), i};
+
+    std::sort(order.begin(), order.end());
+
+    uint32_t foundNum = 0;
+
+    BlobV2 blobV2;
+    if (ParseBlobV2(blob, blobSize, blobV2))
+    {
+        uint32_t entryCount = blobV2.footer.entryCount;
+        uint32_t first = 0; // no key left has a hash lower than the entries before it
+
+        for (auto [keyHash, i] : order)
+        {
+
+            // Gallop from the previous position, then narrow down to the first entry with this hash
+            uint32_t step = 1;
+            while (step <= entryCount - first && GetTocEntry(blobV2, first + step - 1).keyHash < keyHash)
+            {
+                first += step;
+                step *= 2;
+            }
+
+            uint32_t count = std::min(step - 1, entryCount - first);
+            while (count > 0)
+            {
+                uint32_t half = count / 2;
+                if (GetTocEntry(blobV2, first + half).keyHash < keyHash)
+                {
+                    first += half + 1;
+                    count -= half + 1;
+                }
+                else
+                    count = half;
+            }
+
+            // Colliding hashes are told apart by keys
+            const std::string& permutation = keys[i].GetString();
+            for (uint32_t j = first; j < entryCount; j++)
+            {
+                ShaderBlobTocEntry entry = GetTocEntry(blobV2, j);
+                if (entry.keyHash != keyHash || !IsTocEntryValid(blobV2, entry))
+                    break;
+
+                if (entry.keySize == permutation.size() && memcmp(blobV2.data + entry.keyOffset, permutation.data(), permutation.size()) == 0)
+                {
+                    // Compressed v2 permutations can only be read through "ReadPermutationFromBlob"
+                    if (!(entry.flags & ShaderBlobFlag_Compressed))
+                    {
+                        pBinaries[i] = blobV2.data + entry.dataOffset;
+                        pSizes[i] = entry.dataSize;
+                        foundNum++;
+                    }
+
+                    break;
+                }
+            }
+        }
+
+        return foundNum;
+    }
+
+    if (memcmp(blob, g_BlobSignature, g_BlobSignatureSize) != 0)
+    {
+        // This blob is not a permutation blob, it's found only if no permutation is requested
+        for (uint32_t i = 0; i < keyNum; i++)
+        {
+            if (keys[i].IsEmpty())
+            {
+                pBinaries[i] = blob;
+                pSizes[i] = blobSize;
+                foundNum++;
+            }
+        }
+
+        return foundNum;
+    }
+
+    const char* data = static_cast<const char*>(blob) + g_BlobSignatureSize;
+    blobSize -= g_BlobSignatureSize;
+
+    // A single walk through the blob, stops once all keys are found
+    while (blobSize > sizeof(ShaderBlobEntry) && foundNum < keyNum)
+    {
+        ShaderBlobEntry header;
+        memcpy(&header, data, sizeof(header));
+
+        if (header.dataSize == 0)
+            break; // last header in the blob is empty
+
+        if (blobSize < sizeof(ShaderBlobEntry) + header.dataSize + header.permutationSize)
+            break; // insufficient bytes in the blob, cannot continue
+
+        const char* entryPermutation = data + sizeof(ShaderBlobEntry);
+        uint64_t entryHash = HashPermutationKey(entryPermutation, header.permutationSize);
+
+        // Like "FindPermutationInBlob", the first entry with a key wins
+        auto it = std::lower_bound(order.begin(), order.end(), std::make_pair(entryHash, 0u));
+        for (; it != order.end() && it->first == entryHash; ++it)
+        {
+            uint32_t i = it->second;
+            const std::string& permutation = keys[i].GetString();
+            if (!pBinaries[i] && header.permutationSize == permutation.size() && memcmp(entryPermutation, permutation.data(), permutation.size()) == 0)
+            {
+                pBinaries[i] = entryPermutation + header.permutationSize;
+                pSizes[i] = header.dataSize;
+                foundNum++;
+            }
+        }
+
+        size_t offset = sizeof(ShaderBlobEntry) + header.dataSize + header.permutationSize;
+        data += offset;
+        blobSize -= offset;
+    }
+
+    return foundNum;
+}
+
 void EnumeratePermutationsInBlob(const void* blob, size_t blobSize, std::vector<std::string>& permutations)
 {
+    BlobV2 blobV2;
+    if (ParseBlobV2(blob, blobSize, blobV2))
+    {
+        for (uint32_t i = 0; i < blobV2.footer.entryCount; i++)
+        {
+            ShaderBlobTocEntry entry = GetTocEntry(blobV2, i);
+            if (!IsTocEntryValid(blobV2, entry))
+                return;
+
+            if (entry.keySize > 0)
+                permutations.push_back(std::string((const char*)blobV2.data + entry.keyOffset, entry.keySize));
+            else
+                permutations.push_back("<default>");
+        }
+
+        return;
+    }
+
     if (!blob || blobSize < g_BlobSignatureSize)
         return;
 
@@ -219,4 +533,502 @@ std::vector<size_t> GetSortedConstantsIndices(const std::vector<std::string>& co
     return sortedDefinesIndices;
 }
 
+uint32_t GetBlobVersion(const void* blob, size_t blobSize)
+{
+    BlobV2 blobV2;
+    if (ParseBlobV2(blob, blobSize, blobV2))
+        return 2;
+
+    return blob && blobSize >= g_BlobSignatureSize && memcmp(blob, g_BlobSignature, g_BlobSignatureSize) == 0 ? 1 : 0;
+}
+
+bool GetBlobTableOfContents(const void* blob, size_t blobSize, const ShaderBlobTocEntry** pToc, uint32_t* pEntryCount)
+{
+    BlobV2 blobV2;
+    if (!ParseBlobV2(blob, blobSize, blobV2) || (((uintptr_t)blob + blobV2.footer.tocOffset) & 7) != 0)
+        return false;
+
+    for (uint32_t i = 0; i < blobV2.footer.entryCount; i++)
+    {
+        if (!IsTocEntryValid(blobV2, GetTocEntry(blobV2, i)))
+            return false;
+    }
+
+    *pToc = (const ShaderBlobTocEntry*)(blobV2.data + blobV2.footer.tocOffset);
+    *pEntryCount = blobV2.footer.entryCount;
+
+    return true;
+}
+
+// Binary search in a table of contents returned by "GetBlobTableOfContents"
+const ShaderBlobTocEntry* FindInBlobTableOfContents(const void* blob, const ShaderBlobTocEntry* toc, uint32_t entryCount, const char* key, size_t keySize, uint64_t keyHash)
+{
+    const ShaderBlobTocEntry* end = toc + entryCount;
+    const ShaderBlobTocEntry* entry = std::lower_bound(toc, end, keyHash,
+        [](const ShaderBlobTocEntry& e, uint64_t hash) { return e.keyHash < hash; });
+
+    for (; entry != end && entry->keyHash == keyHash; entry++)
+    {
+        if (entry->keySize == keySize && memcmp(static_cast<const char*>(blob) + entry->keyOffset, key, keySize) == 0)
+            return entry;
+    }
+
+    return nullptr;
+}
+
+bool ReadPermutationFromBlob(const void* blob, size_t blobSize, const ShaderConstant* constants, uint32_t numConstants, std::vector<uint8_t>& outBinary)
+{
+    return ReadPermutationFromBlob(blob, blobSize, PermutationKey(constants, numConstants), outBinary);
+}
+
+static bool ReadTocEntry(const BlobV2& blob, uint32_t entryIndex, const ShaderBlobTocEntry& entry, std::vector<uint8_t>& outBinary)
+{
+    // Costs less than the copy, so corrupted payloads never get to the decompressor or the caller
+    if (!IsChecksumValid(blob, entryIndex, entry))
+        return false;
+
+    const uint8_t* stored = blob.data + entry.dataOffset;
+    outBinary.resize(entry.dataSize);
+
+    if (entry.flags & ShaderBlobFlag_Compressed)
+    {
+        const uint8_t* dictionary = blob.data + blob.footer.dictionaryOffset;
+        return DecompressBlock(stored, entry.storedSize, dictionary, blob.footer.dictionarySize, outBinary.data(), outBinary.size());
+    }
+
+    if (entry.storedSize != entry.dataSize)
+        return false;
+
+    memcpy(outBinary.data(), stored, entry.dataSize);
+
+    return true;
+}
+
+bool ReadPermutationFromBlob(const void* blob, size_t blobSize, const PermutationKey& key, std::vector<uint8_t>& outBinary)
+{
+    BlobV2 blobV2;
+    if (ParseBlobV2(blob, blobSize, blobV2))
+    {
+        ShaderBlobTocEntry entry;
+        uint32_t entryIndex;
+        return FindTocEntry(blobV2, key, entry, entryIndex) && ReadTocEntry(blobV2, entryIndex, entry, outBinary);
+    }
+
+    const void* binary = nullptr;
+    size_t binarySize = 0;
+    if (!FindPermutationInBlob(blob, blobSize, key, &binary, &binarySize))
+        return false;
+
+    outBinary.assign(static_cast<const uint8_t*>(binary), static_cast<const uint8_t*>(binary) + binarySize);
+
+    return true;
+}
+
+bool FindPermutationInBlobByIndex(const void* blob, size_t blobSize, uint32_t index, const void** pBinary, size_t* pSize)
+{
+    BlobV2 blobV2;
+    ShaderBlobTocEntry entry;
+    uint32_t entryIndex;
+    if (!pBinary || !pSize || !ParseBlobV2(blob, blobSize, blobV2) || !FindTocEntryByIndex(blobV2, index, entry, entryIndex) || (entry.flags & ShaderBlobFlag_Compressed))
+        return false;
+
+    *pBinary = blobV2.data + entry.dataOffset;
+    *pSize = entry.dataSize;
+
+    return true;
+}
+
+bool ReadPermutationFromBlobByIndex(const void* blob, size_t blobSize, uint32_t index, std::vector<uint8_t>& outBinary)
+{
+    BlobV2 blobV2;
+    ShaderBlobTocEntry entry;
+    uint32_t entryIndex;
+
+    return ParseBlobV2(blob, blobSize, blobV2) && FindTocEntryByIndex(blobV2, index, entry, entryIndex) && ReadTocEntry(blobV2, entryIndex, entry, outBinary);
+}
+
+bool PermutationLayout::Load(const void* blob, size_t blobSize)
+{
+    Clear();
+
+    BlobV2 blobV2;
+    if (!ParseBlobV2(blob, blobSize, blobV2) || !(blobV2.footer.flags & ShaderBlobFooterFlag_Dimensions))
+        return false;
+
+    const uint8_t* p = blobV2.data + blobV2.footer.tocOffset + (uint64_t)blobV2.footer.entryCount * sizeof(ShaderBlobTocEntry);
+    const uint8_t* end = blobV2.data + blobV2.footer.indexOffset;
+
+    auto readUint = [&p, end](uint32_t& value)
+    {
+        if (end - p < (ptrdiff_t)sizeof(value))
+            return false;
+
+        memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+
+        return true;
+    };
+
+    auto readString = [&p, end](std::string& string)
+    {
+        const uint8_t* terminator = (const uint8_t*)memchr(p, 0, end - p);
+        if (!terminator)
+            return false;
+
+        string.assign((const char*)p, terminator - p);
+        p = terminator + 1;
+
+        return true;
+    };
+
+    // Constants are matched to dimensions with a 64-bit mask
+    uint32_t dimensionNum;
+    if (!readUint(dimensionNum) || dimensionNum == 0 || dimensionNum > 64)
+        return false;
+
+    m_Dimensions.resize(dimensionNum);
+    for (PermutationDimension& dimension : m_Dimensions)
+    {
+        uint32_t valueNum;
+        if (!readUint(valueNum) || valueNum == 0 || valueNum > (uint32_t)(end - p) || !readString(dimension.name))
+        {
+            Clear();
+            return false;
+        }
+
+        dimension.values.resize(valueNum);
+        for (std::string& value : dimension.values)
+        {
+            if (!readString(value))
+            {
+                Clear();
+                return false;
+            }
+        }
+    }
+
+    // The last dimension varies the fastest
+    uint64_t indexSize = 1;
+    m_Strides.resize(dimensionNum);
+    for (uint32_t i = dimensionNum; i-- > 0;)
+    {
+        m_Strides[i] = (uint32_t)indexSize;
+        indexSize *= m_Dimensions[i].values.size();
+
+        if (indexSize > blobV2.footer.indexSize)
+            break;
+    }
+
+    if (indexSize != blobV2.footer.indexSize)
+    {
+        Clear();
+        return false;
+    }
+
+    m_IndexSize = (uint32_t)indexSize;
+
+    return true;
+}
+
+void PermutationLayout::Clear()
+{
+    m_Dimensions.clear();
+    m_Strides.clear();
+    m_IndexSize = 0;
+}
+
+uint32_t PermutationLayout::GetIndex(const uint32_t* valueIndices) const
+{
+    uint32_t index = 0;
+    for (size_t i = 0; i < m_Dimensions.size(); i++)
+    {
+        if (valueIndices[i] >= m_Dimensions[i].values.size())
+            return ~0u;
+
+        index += valueIndices[i] * m_Strides[i];
+    }
+
+    return index;
+}
+
+uint32_t PermutationLayout::GetIndex(const ShaderConstant* constants, uint32_t numConstants) const
+{
+    if (numConstants != m_Dimensions.size())
+        return ~0u;
+
+    uint32_t index = 0;
+    uint64_t usedDimensions = 0;
+    for (uint32_t n = 0; n < numConstants; n++)
+    {
+        const ShaderConstant& constant = constants[n];
+
+        size_t dimension = 0;
+        while (dimension < m_Dimensions.size() && m_Dimensions[dimension].name != constant.name)
+            dimension++;
+
+        if (dimension == m_Dimensions.size() || (usedDimensions & (1ull << dimension)))
+            return ~0u;
+
+        const std::vector<std::string>& values = m_Dimensions[dimension].values;
+        size_t value = 0;
+        while (value < values.size() && values[value] != constant.value)
+            value++;
+
+        if (value == values.size())
+            return ~0u;
+
+        index += (uint32_t)value * m_Strides[dimension];
+        usedDimensions |= 1ull << dimension;
+    }
+
+    return index;
+}
+
+const uint32_t* GetBlobChecksums(const void* blob, size_t blobSize)
+{
+    BlobV2 blobV2;
+    if (!ParseBlobV2(blob, blobSize, blobV2) || !(blobV2.footer.flags & ShaderBlobFooterFlag_Checksums))
+        return nullptr;
+
+    return (const uint32_t*)(blobV2.data + blobV2.footer.indexOffset + (uint64_t)blobV2.footer.indexSize * sizeof(uint32_t));
+}
+
+bool VerifyBlob(const void* blob, size_t blobSize, std::vector<std::string>* pCorrupted)
+{
+    BlobV2 blobV2;
+    if (ParseBlobV2(blob, blobSize, blobV2))
+    {
+        bool isValid = true;
+        for (uint32_t i = 0; i < blobV2.footer.entryCount; i++)
+        {
+            ShaderBlobTocEntry entry = GetTocEntry(blobV2, i);
+            if (!IsTocEntryValid(blobV2, entry))
+                return false; // the rest of the blob can't be trusted
+
+            if (!IsChecksumValid(blobV2, i, entry))
+            {
+                if (pCorrupted)
+                    pCorrupted->push_back(std::string((const char*)blobV2.data + entry.keyOffset, entry.keySize));
+
+                isValid = false;
+            }
+        }
+
+        return isValid;
+    }
+
+    // v1 blobs have no checksums, only their structure is checked
+    if (!blob || blobSize < g_BlobSignatureSize || memcmp(blob, g_BlobSignature, g_BlobSignatureSize) != 0)
+        return false;
+
+    const uint8_t* p = static_cast<const uint8_t*>(blob) + g_BlobSignatureSize;
+    size_t remainingSize = blobSize - g_BlobSignatureSize;
+    while (remainingSize > sizeof(ShaderBlobEntry))
+    {
+        ShaderBlobEntry header;
+        memcpy(&header, p, sizeof(header));
+        if (header.dataSize == 0)
+            break;
+
+        uint64_t entrySize = sizeof(ShaderBlobEntry) + (uint64_t)header.permutationSize + header.dataSize;
+        if (remainingSize < entrySize)
+            return false;
+
+        p += entrySize;
+        remainingSize -= entrySize;
+    }
+
+    return true;
+}
+
+BlobWriter::BlobWriter(WriteFileCallback write, void* context, const BlobWriterSettings& settings)
+    : m_Write(write), m_Context(context), m_Settings(settings)
+{
+    if (!m_Settings.compress)
+        m_Settings.dictionary.clear();
+    else
+        m_Compressor = std::make_unique<BlockCompressor>(m_Settings.dictionary.data(), m_Settings.dictionary.size());
+}
+
+BlobWriter::~BlobWriter() = default;
+
+bool BlobWriter::Write(const void* data, size_t size)
+{
+    m_Offset += size;
+
+    return size == 0 || m_Write(data, size, m_Context);
+}
+
+bool BlobWriter::WritePadding(uint32_t alignment)
+{
+    static const uint8_t zeros[256] = {};
+
+    uint64_t size = alignment > 1 ? (alignment - m_Offset % alignment) % alignment : 0;
+    while (size)
+    {
+        size_t chunk = (size_t)std::min<uint64_t>(size, sizeof(zeros));
+        if (!Write(zeros, chunk))
+            return false;
+
+        size -= chunk;
+    }
+
+    return true;
+}
+
+bool BlobWriter::Begin()
+{
+    m_IsStarted = true;
+
+    bool success = Write(g_BlobSignatureV2, g_BlobSignatureSize);
+
+    m_DictionaryOffset = m_Offset;
+    success &= Write(m_Settings.dictionary.data(), m_Settings.dictionary.size());
+
+    return success;
+}
+
+bool BlobWriter::AddPermutation(const std::string& permutationKey, const void* binary, size_t binarySize, uint32_t index)
+{
+    if (!m_IsStarted && !Begin())
+        return false;
+
+    ShaderBlobTocEntry entry = {};
+    entry.keyHash = HashPermutationKey(permutationKey.data(), permutationKey.size());
+    entry.keyOffset = m_Keys.size(); // relative to the keys, until "Finish"
+    entry.keySize = (uint32_t)permutationKey.size();
+    entry.dataSize = (uint32_t)binarySize;
+    entry.storedSize = (uint32_t)binarySize;
+
+    m_Keys += permutationKey;
+    m_Indices.push_back(index);
+    m_DataSize += binarySize;
+
+    // A payload identical to a previous one is referenced instead of written again
+    uint64_t hash = 0;
+    uint64_t checkHash = 0;
+    if (m_Settings.deduplicate)
+    {
+        hash = HashData(binary, binarySize);
+        checkHash = HashData(binary, binarySize, hash);
+
+        auto it = m_Payloads.find(hash);
+        if (it != m_Payloads.end() && it->second.dataSize == binarySize && it->second.checkHash == checkHash)
+        {
+            entry.dataOffset = it->second.dataOffset;
+            entry.storedSize = it->second.storedSize;
+            entry.flags = it->second.flags;
+            m_Toc.push_back(entry);
+            m_Checksums.push_back(it->second.checksum);
+
+            m_DuplicateNum++;
+            m_DuplicateSize += binarySize;
+
+            return true;
+        }
+    }
+
+    // Payloads of memory mapped blobs are used in place, they are aligned for the consumer
+    if (!WritePadding(m_Settings.alignment))
+        return false;
+
+    entry.dataOffset = m_Offset;
+
+    const void* stored = binary;
+    if (m_Compressor && m_Compressor->Compress(binary, binarySize, m_Compressed))
+    {
+        stored = m_Compressed.data();
+        entry.storedSize = (uint32_t)m_Compressed.size();
+        entry.flags |= ShaderBlobFlag_Compressed;
+    }
+
+    uint32_t checksum = m_Settings.checksums ? Crc32c(stored, entry.storedSize) : 0;
+
+    m_Toc.push_back(entry);
+    m_Checksums.push_back(checksum);
+
+    if (m_Settings.deduplicate)
+        m_Payloads.emplace(hash, Payload{entry.dataOffset, checkHash, entry.dataSize, entry.storedSize, entry.flags, checksum});
+
+    return Write(stored, entry.storedSize);
+}
+
+bool BlobWriter::Finish()
+{
+    if (!m_IsStarted && !Begin())
+        return false;
+
+    uint64_t keysOffset = m_Offset;
+    bool success = Write(m_Keys.data(), m_Keys.size());
+
+    // The table of contents is 8-byte aligned
+    success &= WritePadding(8);
+
+    ShaderBlobFooter footer = {};
+    footer.tocOffset = m_Offset;
+    footer.dictionaryOffset = m_DictionaryOffset;
+    footer.dictionarySize = (uint32_t)m_Settings.dictionary.size();
+    footer.entryCount = (uint32_t)m_Toc.size();
+    footer.version = g_BlobVersionV2;
+    memcpy(footer.signature, g_BlobSignatureV2, g_BlobSignatureSize);
+
+    // Sorted for binary searches, entries with the same hash stay in the order they were added
+    std::vector<uint32_t> order(m_Toc.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return m_Toc[a].keyHash < m_Toc[b].keyHash; });
+
+    std::vector<ShaderBlobTocEntry> toc(m_Toc.size());
+    std::vector<uint32_t> indexTable(m_Settings.indexSize, ~0u);
+    std::vector<uint32_t> checksums(m_Settings.checksums ? m_Toc.size() : 0);
+    for (uint32_t i = 0; i < (uint32_t)order.size(); i++)
+    {
+        toc[i] = m_Toc[order[i]];
+        toc[i].keyOffset += keysOffset;
+
+        if (m_Settings.checksums)
+            checksums[i] = m_Checksums[order[i]];
+
+        uint32_t index = m_Indices[order[i]];
+        if (index < indexTable.size())
+            indexTable[index] = i;
+    }
+
+    success &= Write(toc.data(), toc.size() * sizeof(ShaderBlobTocEntry));
+
+    if (!m_Settings.dimensions.empty() && m_Settings.indexSize)
+    {
+        std::vector<uint8_t> descriptor;
+        auto appendUint = [&descriptor](uint32_t value) { descriptor.insert(descriptor.end(), (const uint8_t*)&value, (const uint8_t*)&value + sizeof(value)); };
+        auto appendString = [&descriptor](const std::string& string) { descriptor.insert(descriptor.end(), string.c_str(), string.c_str() + string.size() + 1); };
+
+        appendUint((uint32_t)m_Settings.dimensions.size());
+        for (const PermutationDimension& dimension : m_Settings.dimensions)
+        {
+            appendUint((uint32_t)dimension.values.size());
+            appendString(dimension.name);
+            for (const std::string& value : dimension.values)
+                appendString(value);
+        }
+
+        descriptor.resize((descriptor.size() + 3) & ~size_t(3), 0);
+
+        footer.flags |= ShaderBlobFooterFlag_Dimensions;
+        success &= Write(descriptor.data(), descriptor.size());
+    }
+
+    footer.indexOffset = m_Offset;
+    footer.indexSize = (uint32_t)indexTable.size();
+    success &= Write(indexTable.data(), indexTable.size() * sizeof(uint32_t));
+
+    if (m_Settings.checksums)
+    {
+        footer.flags |= ShaderBlobFooterFlag_Checksums;
+        success &= Write(checksums.data(), checksums.size() * sizeof(uint32_t));
+    }
+
+    success &= Write(&footer, sizeof(footer));
+
+    return success;
+}
+
 } // namespace ShaderMake
\ No newline at end of file
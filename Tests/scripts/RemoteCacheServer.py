@@ -0,0 +1,84 @@
+# Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+# Licensed under the MIT license, see LICENSE.txt.
+#
+# Minimal remote cache server for "RemoteCacheTest": runs the test executable against it and returns its exit code.
+#  GET/PUT <path>    - in-memory object store
+#  GET /_stats/<key> - "<gets> <puts>" received for "/cache/<key>"
+#  /hang/...         - never answers in time, for the timeout fallback
+# Usage: RemoteCacheServer.py <test executable> [args...]
+
+import http.server
+import subprocess
+import sys
+import threading
+import time
+
+HANG_SECONDS = 10
+
+store = {}
+counters = {}
+lock = threading.Lock()
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def reply(self, status, body=b""):
+        self.send_response(status)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def count(self, index):
+        with lock:
+            counter = counters.setdefault(self.path, [0, 0])
+            counter[index] += 1
+
+    def do_GET(self):
+        if self.path.startswith("/hang/"):
+            time.sleep(HANG_SECONDS)
+            return
+
+        if self.path.startswith("/_stats/"):
+            with lock:
+                gets, puts = counters.get("/cache/" + self.path[len("/_stats/"):], [0, 0])
+            self.reply(200, ("%d %d" % (gets, puts)).encode())
+            return
+
+        self.count(0)
+        with lock:
+            data = store.get(self.path)
+        if data is None:
+            self.reply(404)
+        else:
+            self.reply(200, data)
+
+    def do_PUT(self):
+        if self.path.startswith("/hang/"):
+            time.sleep(HANG_SECONDS)
+            return
+
+        self.count(1)
+        data = self.rfile.read(int(self.headers.get("Content-Length", "0")))
+        with lock:
+            store[self.path] = data
+        self.reply(201)
+
+    def log_message(self, format, *args):
+        pass
+
+
+def main():
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+    server.daemon_threads = True
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+
+    url = "http://127.0.0.1:%d" % server.server_address[1]
+    result = subprocess.run(sys.argv[1:] + [url + "/cache", url + "/_stats", url + "/hang"])
+
+    server.shutdown()
+    return result.returncode
+
+
+if __name__ == "__main__":
+    sys.exit(main())
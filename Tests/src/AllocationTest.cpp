@@ -0,0 +1,187 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+// Lookups with a precomputed "PermutationKey" must not allocate: global "operator new" is replaced with a counting one
+
+#include "TestUtils.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace ShaderMake;
+
+static std::atomic<uint64_t> g_Allocations = 0;
+
+void *operator new(size_t size)
+{
+    g_Allocations++;
+
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+// Keys are longer than any small string buffer, so that a copy of a key would allocate
+static const char *g_Keys[] = {
+    "LIGHTING_MODEL=0 SHADOW_QUALITY=0 USE_NORMAL_MAP=0",
+    "LIGHTING_MODEL=0 SHADOW_QUALITY=1 USE_NORMAL_MAP=1",
+    "LIGHTING_MODEL=1 SHADOW_QUALITY=0 USE_NORMAL_MAP=1",
+    "LIGHTING_MODEL=1 SHADOW_QUALITY=2 USE_NORMAL_MAP=0",
+};
+
+static bool Append(const void *data, size_t size, void *context)
+{
+    std::vector<uint8_t> &blob = *(std::vector<uint8_t> *)context;
+    blob.insert(blob.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+
+    return true;
+}
+
+// v2 readers need 8-byte aligned memory, as memory mapped files are
+static std::vector<uint64_t> Align(const std::vector<uint8_t> &blob)
+{
+    std::vector<uint64_t> aligned((blob.size() + 7) / 8);
+    memcpy(aligned.data(), blob.data(), blob.size());
+
+    return aligned;
+}
+
+static void CheckLookups(const char *name, const void *blob, size_t blobSize, const std::vector<PermutationKey> &keys, const PermutationKey &missingKey)
+{
+    uint32_t foundNum = 0;
+    bool isMissingFound = true;
+
+    uint64_t allocations = g_Allocations;
+    for (const PermutationKey &key : keys)
+    {
+        const void *binary = nullptr;
+        size_t size = 0;
+        foundNum += FindPermutationInBlob(blob, blobSize, key, &binary, &size) ? 1 : 0;
+    }
+
+    const void *binary = nullptr;
+    size_t size = 0;
+    isMissingFound = FindPermutationInBlob(blob, blobSize, missingKey, &binary, &size);
+    allocations = g_Allocations - allocations;
+
+    if (allocations)
+        Utils::Printf(RED "%s: %llu allocation(s)\n", name, (unsigned long long)allocations);
+
+    CHECK(allocations == 0);
+    CHECK(foundNum == keys.size());
+    CHECK(!isMissingFound);
+}
+
+int main()
+{
+    std::vector<PermutationKey> keys;
+    for (const char *key : g_Keys)
+        keys.push_back(PermutationKey(std::string(key)));
+
+    PermutationKey missingKey(std::string("LIGHTING_MODEL=2 SHADOW_QUALITY=2 USE_NORMAL_MAP=1"));
+
+    // v1
+    {
+        std::vector<uint8_t> blob;
+        CHECK(WriteFileHeader(Append, &blob));
+        for (const char *key : g_Keys)
+            CHECK(WritePermutation(Append, &blob, key, key, strlen(key)));
+
+        CheckLookups("FindPermutationInBlob (v1)", blob.data(), blob.size(), keys, missingKey);
+    }
+
+    // v2 and the archive, which is a v2 blob keyed by "<shader>:<permutation>"
+    {
+        std::vector<uint8_t> blob;
+        std::vector<uint8_t> archive;
+        {
+            BlobWriter writer(Append, &blob, BlobWriterSettings());
+            BlobWriter archiveWriter(Append, &archive, BlobWriterSettings());
+            for (const char *key : g_Keys)
+            {
+                CHECK(writer.AddPermutation(key, key, strlen(key)));
+                CHECK(archiveWriter.AddPermutation(MakeArchiveKey("shader", key), key, strlen(key)));
+            }
+
+            CHECK(writer.Finish());
+            CHECK(archiveWriter.Finish());
+        }
+
+        std::vector<uint64_t> alignedBlob = Align(blob);
+        CheckLookups("FindPermutationInBlob (v2)", alignedBlob.data(), blob.size(), keys, missingKey);
+
+        std::vector<uint64_t> alignedArchive = Align(archive);
+        ShaderArchive shaderArchive;
+        CHECK(shaderArchive.Open(alignedArchive.data(), archive.size()));
+
+        std::vector<PermutationKey> archiveKeys;
+        for (const char *key : g_Keys)
+            archiveKeys.push_back(PermutationKey(MakeArchiveKey("shader", key)));
+
+        uint32_t foundNum = 0;
+        uint64_t allocations = g_Allocations;
+        for (const PermutationKey &key : archiveKeys)
+        {
+            const void *binary = nullptr;
+            size_t size = 0;
+            foundNum += shaderArchive.Find(key, &binary, &size) ? 1 : 0;
+        }
+        allocations = g_Allocations - allocations;
+
+        if (allocations)
+            Utils::Printf(RED "ShaderArchive::Find: %llu allocation(s)\n", (unsigned long long)allocations);
+
+        CHECK(allocations == 0);
+        CHECK(foundNum == archiveKeys.size());
+    }
+
+    return TestResult("AllocationTest");
+}
@@ -0,0 +1,198 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+// Runs against "scripts/RemoteCacheServer.py": RemoteCacheTest <cache url> <stats url> <hanging url>
+
+#include "TestUtils.h"
+
+#include <chrono>
+#include <cstring>
+
+using namespace ShaderMake;
+
+#define TEST_TIMEOUT_MS 300
+
+static std::string g_Url;
+static std::string g_StatsUrl;
+static std::string g_HangUrl;
+
+// "<gets> <puts>" the server received for "key"
+static void GetServerCounters(const std::string &key, uint32_t &outGets, uint32_t &outPuts)
+{
+    outGets = outPuts = ~0u;
+
+    RemoteCache stats(g_StatsUrl, true, 1000);
+    std::vector<uint8_t> data;
+    if (stats.Get(key, data))
+    {
+        std::string text(data.begin(), data.end());
+        sscanf(text.c_str(), "%u %u", &outGets, &outPuts);
+    }
+}
+
+static std::unique_ptr<CompileCache> CreateCache(const std::filesystem::path &directory, const std::string &url, bool isReadOnly, uint32_t timeoutMs)
+{
+    std::unique_ptr<CompileCache> cache = std::make_unique<CompileCache>(directory, 0);
+    cache->SetRemote(std::make_unique<RemoteCache>(url, isReadOnly, timeoutMs));
+
+    return cache;
+}
+
+static bool LookUp(CompileCache &cache, const std::string &key)
+{
+    std::shared_ptr<RemoteLookup> lookup = cache.LookupRemote(key);
+
+    return lookup && cache.FinishRemoteLookup(key, *lookup);
+}
+
+static void TestHit(const std::filesystem::path &root)
+{
+    const char binary[] = "binary";
+    const std::string key = "a1b2c3d4e5f60001";
+
+    {
+        std::unique_ptr<CompileCache> writer = CreateCache(root / "writer", g_Url, false, 1000);
+        CHECK(writer->Store(key, binary, sizeof(binary)));
+        writer->GetRemote()->Flush();
+    }
+
+    // A fresh local cache misses, the remote lookup fills it
+    std::unique_ptr<CompileCache> reader = CreateCache(root / "reader", g_Url, false, 1000);
+    std::vector<uint8_t> data;
+    CHECK(!reader->Fetch(key, data));
+    CHECK(LookUp(*reader, key));
+    CHECK(reader->Fetch(key, data));
+    CHECK(data.size() == sizeof(binary) && memcmp(data.data(), binary, sizeof(binary)) == 0);
+
+    uint32_t gets, puts;
+    GetServerCounters(key, gets, puts);
+    CHECK(gets == 1 && puts == 1);
+}
+
+static void TestFailure(const std::filesystem::path &root)
+{
+    const std::string diagnostics = "shader.hlsl:1:1: error: failure";
+    const std::string key = "a1b2c3d4e5f60002";
+
+    {
+        std::unique_ptr<CompileCache> writer = CreateCache(root / "writer", g_Url, false, 1000);
+        CHECK(writer->StoreFailure(key, diagnostics));
+        writer->GetRemote()->Flush();
+    }
+
+    // Success and failure come with the same request
+    std::unique_ptr<CompileCache> reader = CreateCache(root / "reader", g_Url, false, 1000);
+    std::vector<uint8_t> data;
+    std::string cachedDiagnostics;
+    CHECK(LookUp(*reader, key));
+    CHECK(!reader->Fetch(key, data));
+    CHECK(reader->FetchFailure(key, cachedDiagnostics));
+    CHECK(cachedDiagnostics == diagnostics);
+
+    uint32_t gets, puts;
+    GetServerCounters(key, gets, puts);
+    CHECK(gets == 1 && puts == 1);
+}
+
+static void TestMiss(const std::filesystem::path &root)
+{
+    const std::string key = "a1b2c3d4e5f60003";
+
+    std::unique_ptr<CompileCache> reader = CreateCache(root / "reader", g_Url, false, 1000);
+    std::vector<uint8_t> data;
+    std::string diagnostics;
+    CHECK(!LookUp(*reader, key));
+    CHECK(!reader->Fetch(key, data));
+    CHECK(!reader->FetchFailure(key, diagnostics));
+    CHECK(reader->GetRemote()->IsAvailable());
+}
+
+static void TestReadOnly(const std::filesystem::path &root)
+{
+    const char binary[] = "read-only";
+    const std::string key = "a1b2c3d4e5f60004";
+
+    // Stored locally, never uploaded
+    std::unique_ptr<CompileCache> cache = CreateCache(root / "readonly", g_Url, true, 1000);
+    std::vector<uint8_t> data;
+    CHECK(cache->Store(key, binary, sizeof(binary)));
+    CHECK(cache->StoreFailure(key, "diagnostics"));
+    cache->GetRemote()->Flush();
+    CHECK(cache->Fetch(key, data));
+
+    uint32_t gets, puts;
+    GetServerCounters(key, gets, puts);
+    CHECK(gets == 0 && puts == 0);
+}
+
+static void TestTimeout(const std::filesystem::path &root)
+{
+    const char binary[] = "local";
+    const std::string key = "a1b2c3d4e5f60005";
+
+    std::unique_ptr<CompileCache> cache = CreateCache(root / "timeout", g_HangUrl, false, TEST_TIMEOUT_MS);
+
+    // The first timeout is a miss and disables the remote tier
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!LookUp(*cache, key));
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsedMs < TEST_TIMEOUT_MS * 5);
+    CHECK(!cache->GetRemote()->IsAvailable());
+
+    // Then the local tier works on its own, without waiting for the server
+    std::vector<uint8_t> data;
+    start = std::chrono::steady_clock::now();
+    CHECK(cache->LookupRemote(key) == nullptr);
+    CHECK(cache->Store(key, binary, sizeof(binary)));
+    cache->GetRemote()->Flush();
+    CHECK(cache->Fetch(key, data));
+    elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsedMs < TEST_TIMEOUT_MS);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        Utils::Printf("Usage: RemoteCacheTest <cache url> <stats url> <hanging url>\n");
+        return 1;
+    }
+
+    g_Url = argv[1];
+    g_StatsUrl = argv[2];
+    g_HangUrl = argv[3];
+
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "ShaderMakeRemoteCacheTest";
+    std::error_code ec;
+    std::filesystem::remove_all(root, ec);
+
+    TestHit(root / "hit");
+    TestFailure(root / "failure");
+    TestMiss(root / "miss");
+    TestReadOnly(root / "readonly");
+    TestTimeout(root / "timeout");
+
+    std::filesystem::remove_all(root, ec);
+
+    return TestResult("RemoteCacheTest");
+}
@@ -0,0 +1,52 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#define SHADERMAKE_COLORS
+#include <ShaderMake/ShaderMake.h>
+
+// Minimal checks for the test executables: a failed check is reported and fails the test, the test goes on
+static uint32_t g_FailedChecks = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            ShaderMake::Utils::Printf(RED "FAILED: %s (%s:%d)\n", #condition, __FILE__, __LINE__); \
+            g_FailedChecks++; \
+        } \
+    } while (0)
+
+static int TestResult(const char *name)
+{
+    if (g_FailedChecks)
+    {
+        ShaderMake::Utils::Printf(RED "%s: %u check(s) failed\n", name, g_FailedChecks);
+        return 1;
+    }
+
+    ShaderMake::Utils::Printf(GREEN "%s: passed\n", name);
+    return 0;
+}
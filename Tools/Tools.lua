@@ -0,0 +1,104 @@
+project "ShaderMakeCache"
+    kind "ConsoleApp"
+    language "c++"
+    cppdialect "c++20"
+
+targetdir (OUTPUT_DIR)
+objdir (INTOUTPUT_DIR)
+
+files {
+    "%{prj.location}/src/ShaderMakeCache.cpp",
+}
+
+includedirs {
+    "%{wks.location}/ShaderMake/include",
+}
+
+links {
+    "ShaderMake"
+}
+
+filter "system:windows"
+defines {
+    "WIN32_LEAN_AND_MEAN",
+    "NOMINMAX",
+    "_CRT_SECURE_NO_WARNINGS"
+}
+
+filter "configurations:Debug"
+runtime "Debug"
+symbols "on"
+
+filter "configurations:Release"
+runtime "Release"
+symbols "off"
+
+project "ShaderMakeBlob"
+    kind "ConsoleApp"
+    language "c++"
+    cppdialect "c++20"
+
+targetdir (OUTPUT_DIR)
+objdir (INTOUTPUT_DIR)
+
+files {
+    "%{prj.location}/src/ShaderMakeBlob.cpp",
+}
+
+includedirs {
+    "%{wks.location}/ShaderMake/include",
+}
+
+links {
+    "ShaderMake"
+}
+
+filter "system:windows"
+defines {
+    "WIN32_LEAN_AND_MEAN",
+    "NOMINMAX",
+    "_CRT_SECURE_NO_WARNINGS"
+}
+
+filter "configurations:Debug"
+runtime "Debug"
+symbols "on"
+
+filter "configurations:Release"
+runtime "Release"
+symbols "off"
+
+project "ShaderMakeBench"
+    kind "ConsoleApp"
+    language "c++"
+    cppdialect "c++20"
+
+targetdir (OUTPUT_DIR)
+objdir (INTOUTPUT_DIR)
+
+files {
+    "%{prj.location}/src/ShaderMakeBench.cpp",
+}
+
+includedirs {
+    "%{wks.location}/ShaderMake/include",
+}
+
+links {
+    "ShaderMake"
+}
+
+filter "system:windows"
+defines {
+    "WIN32_LEAN_AND_MEAN",
+    "NOMINMAX",
+    "_CRT_SECURE_NO_WARNINGS"
+}
+
+filter "configurations:Debug"
+runtime "Debug"
+symbols "on"
+
+filter "configurations:Release"
+runtime "Release"
+symbols "off"
@@ -0,0 +1,583 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#define SHADERMAKE_COLORS
+#include <ShaderMake/ShaderMake.h>
+
+#include <chrono>
+#include <random>
+
+using namespace ShaderMake;
+
+// Every measurement repeats its work for at least this long
+#define BENCH_MIN_TIME 0.2 // s
+
+// Lookups per measured pass, larger blobs are sampled
+#define BENCH_LOOKUPS_PER_PASS 1024
+
+static void PrintUsage()
+{
+    Utils::Printf(
+        "Usage:\n"
+        "  ShaderMakeBench lookup [--max-permutations <N>] [--binary-size <bytes>]\n"
+        "  ShaderMakeBench compression [--permutations <N>] [--binary-size <bytes>] [--blob <file>]\n"
+        "  ShaderMakeBench text [--size <MB>]\n"
+        "  ShaderMakeBench crc [--size <MB>]\n"
+        "Build with optimizations, timings of unoptimized builds are meaningless.\n");
+}
+
+// Keeps results alive, so that the measured work is not optimized away
+static volatile size_t g_Sink = 0;
+
+// Seconds per call of "body", repeated until "BENCH_MIN_TIME" is reached. "body" returns a value depending on its work.
+template<typename Body>
+static double Measure(Body body)
+{
+    uint64_t callNum = 0;
+    size_t sink = 0;
+    double elapsed = 0.0;
+    auto start = std::chrono::steady_clock::now();
+
+    while (elapsed < BENCH_MIN_TIME)
+    {
+        sink += body();
+        callNum++;
+
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    g_Sink = sink;
+
+    return elapsed / callNum;
+}
+
+static bool Append(const void *data, size_t size, void *context)
+{
+    std::vector<uint8_t> &blob = *(std::vector<uint8_t> *)context;
+    blob.insert(blob.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+
+    return true;
+}
+
+// v2 readers need 8-byte aligned memory, as memory mapped files are
+struct AlignedBlob
+{
+    std::vector<uint64_t> storage;
+    size_t size = 0;
+
+    explicit AlignedBlob(const std::vector<uint8_t> &blob) : storage((blob.size() + 7) / 8), size(blob.size())
+    {
+        memcpy(storage.data(), blob.data(), blob.size());
+    }
+
+    const void *data() const { return storage.data(); }
+};
+
+// Synthetic permutations of one shader: keys of 4-value defines, binaries share an "instruction" stream (with some
+// repeated runs, as code has) and differ in a few percent of the instructions
+struct Permutations
+{
+    std::vector<std::string> keys;
+    std::vector<std::vector<uint8_t>> binaries;
+};
+
+static Permutations GeneratePermutations(uint32_t permutationNum, size_t binarySize)
+{
+    std::mt19937 random(1);
+
+    uint32_t dimensionNum = 1;
+    while ((1ull << (2 * dimensionNum)) < permutationNum)
+        dimensionNum++;
+
+    std::vector<uint32_t> instructions(4096);
+    for (uint32_t &instruction : instructions)
+        instruction = random();
+
+    std::vector<uint32_t> base(binarySize / sizeof(uint32_t));
+    for (size_t i = 0; i < base.size(); i++)
+    {
+        if (i >= 64 && random() % 16 == 0)
+        {
+            size_t length = std::min<size_t>(8 + random() % 24, base.size() - i);
+            size_t from = random() % (i - length);
+            memcpy(&base[i], &base[from], length * sizeof(uint32_t));
+            i += length - 1;
+        }
+        else
+            base[i] = instructions[random() % instructions.size()];
+    }
+
+    Permutations permutations;
+    permutations.keys.resize(permutationNum);
+    permutations.binaries.resize(permutationNum);
+
+    for (uint32_t i = 0; i < permutationNum; i++)
+    {
+        std::string &key = permutations.keys[i];
+        for (uint32_t d = 0; d < dimensionNum; d++)
+        {
+            char define[32];
+            snprintf(define, sizeof(define), "%sDEFINE_%u=%u", d ? " " : "", d, (i >> (2 * d)) & 3);
+            key += define;
+        }
+
+        std::vector<uint32_t> words = base;
+        for (size_t j = 0; j < words.size() / 32; j++)
+            words[random() % words.size()] = random();
+
+        std::vector<uint8_t> &binary = permutations.binaries[i];
+        binary.resize(binarySize);
+        memcpy(binary.data(), words.data(), words.size() * sizeof(uint32_t));
+    }
+
+    return permutations;
+}
+
+static int Lookup(uint32_t maxPermutationNum, size_t binarySize)
+{
+    Utils::Printf(WHITE "Lookup cost by permutation count, %zu byte binaries:\n", binarySize);
+    Utils::Printf("  %12s %14s %14s %14s %14s\n", "permutations", "v1 (ns)", "v2 (ns)", "v2 index (ns)", "v2 batch (ns)");
+
+    for (uint32_t permutationNum = 16; permutationNum <= maxPermutationNum; permutationNum *= 4)
+    {
+        Permutations permutations = GeneratePermutations(permutationNum, binarySize);
+
+        std::vector<uint8_t> blobV1;
+        WriteFileHeader(Append, &blobV1);
+        for (uint32_t i = 0; i < permutationNum; i++)
+            WritePermutation(Append, &blobV1, permutations.keys[i], permutations.binaries[i].data(), binarySize);
+
+        std::vector<uint8_t> blobV2;
+        {
+            BlobWriterSettings settings;
+            settings.indexSize = permutationNum;
+
+            BlobWriter writer(Append, &blobV2, settings);
+            for (uint32_t i = 0; i < permutationNum; i++)
+                writer.AddPermutation(permutations.keys[i], permutations.binaries[i].data(), binarySize, i);
+
+            if (!writer.Finish())
+            {
+                Utils::Printf(RED "ERROR: Can't write a v2 blob!\n");
+                return 1;
+            }
+        }
+
+        AlignedBlob alignedV1(blobV1);
+        AlignedBlob alignedV2(blobV2);
+
+        // Lookups in random order, keys are built once as in a pipeline cache
+        std::mt19937 random(2);
+        uint32_t lookupNum = std::min(permutationNum, (uint32_t)BENCH_LOOKUPS_PER_PASS);
+        std::vector<uint32_t> indices(lookupNum);
+        std::vector<PermutationKey> keys;
+        keys.reserve(lookupNum);
+        for (uint32_t &index : indices)
+        {
+            index = random() % permutationNum;
+            keys.push_back(PermutationKey(permutations.keys[index]));
+        }
+
+        auto findAll = [&keys](const AlignedBlob &blob)
+        {
+            size_t totalSize = 0;
+            for (const PermutationKey &key : keys)
+            {
+                const void *binary = nullptr;
+                size_t size = 0;
+                FindPermutationInBlob(blob.data(), blob.size, key, &binary, &size);
+                totalSize += size;
+            }
+
+            return totalSize;
+        };
+
+        double v1 = Measure([&]() { return findAll(alignedV1); });
+        double v2 = Measure([&]() { return findAll(alignedV2); });
+
+        double v2Index = Measure([&]()
+        {
+            size_t totalSize = 0;
+            for (uint32_t index : indices)
+            {
+                const void *binary = nullptr;
+                size_t size = 0;
+                FindPermutationInBlobByIndex(alignedV2.data(), alignedV2.size, index, &binary, &size);
+                totalSize += size;
+            }
+
+            return totalSize;
+        });
+
+        std::vector<const void *> binaries(lookupNum);
+        std::vector<size_t> sizes(lookupNum);
+        double v2Batch = Measure([&]()
+        {
+            return (size_t)FindPermutationsInBlob(alignedV2.data(), alignedV2.size, keys.data(), lookupNum, binaries.data(), sizes.data());
+        });
+
+        const double toNs = 1e9 / lookupNum;
+        Utils::Printf("  %12u %14.1f %14.1f %14.1f %14.1f\n", permutationNum, v1 * toNs, v2 * toNs, v2Index * toNs, v2Batch * toNs);
+    }
+
+    return 0;
+}
+
+// Permutations of an existing blob, for numbers on real shaders
+static bool LoadPermutations(const char *file, Permutations &outPermutations)
+{
+    std::vector<uint8_t> data;
+    if (!Utils::ReadBinaryFile(file, data))
+        return false;
+
+    AlignedBlob blob(data);
+    std::vector<std::string> keys;
+    EnumeratePermutationsInBlob(blob.data(), blob.size, keys);
+
+    for (std::string &key : keys)
+    {
+        if (key == "<default>")
+            key.clear();
+
+        std::vector<uint8_t> binary;
+        if (!ReadPermutationFromBlob(blob.data(), blob.size, PermutationKey(key), binary))
+            continue;
+
+        outPermutations.keys.push_back(key);
+        outPermutations.binaries.push_back(std::move(binary));
+    }
+
+    if (outPermutations.keys.empty())
+    {
+        Utils::Printf(RED "ERROR: Blob '%s' has no permutations!\n", file);
+        return false;
+    }
+
+    return true;
+}
+
+static int Compression(uint32_t permutationNum, size_t binarySize, const char *blobFile)
+{
+    Permutations permutations;
+    if (blobFile)
+    {
+        if (!LoadPermutations(blobFile, permutations))
+            return 1;
+    }
+    else
+        permutations = GeneratePermutations(permutationNum, binarySize);
+
+    uint64_t totalSize = 0;
+    std::vector<uint8_t> samples;
+    std::vector<size_t> sampleSizes;
+    for (const std::vector<uint8_t> &binary : permutations.binaries)
+    {
+        totalSize += binary.size();
+        samples.insert(samples.end(), binary.begin(), binary.end());
+        sampleSizes.push_back(binary.size());
+    }
+
+    Utils::Printf(WHITE "Compression of %zu permutations (%s), %.1f KB:\n", permutations.keys.size(), blobFile ? blobFile : "synthetic", totalSize / 1024.0);
+    Utils::Printf("  %-16s %12s %8s %14s %14s\n", "", "size (KB)", "ratio", "encode (MB/s)", "decode (MB/s)");
+
+    // The dictionary is sized as in "Context::TrainBlobDictionary"
+    std::vector<uint8_t> dictionary;
+    double training = Measure([&]()
+    {
+        dictionary = TrainDictionary(samples.data(), sampleSizes, std::min<size_t>(2 * samples.size() / sampleSizes.size(), 1 << 20));
+        return dictionary.size();
+    });
+
+    struct Variant
+    {
+        const char *name;
+        bool compress;
+        bool useDictionary;
+    };
+
+    const Variant variants[] = {
+        { "uncompressed", false, false },
+        { "compressed", true, false },
+        { "dictionary", true, true },
+    };
+
+    std::vector<PermutationKey> keys;
+    for (const std::string &key : permutations.keys)
+        keys.push_back(PermutationKey(key));
+
+    for (const Variant &variant : variants)
+    {
+        BlobWriterSettings settings;
+        settings.compress = variant.compress;
+        settings.deduplicate = false; // only the codec is measured
+        if (variant.useDictionary)
+            settings.dictionary = dictionary;
+
+        std::vector<uint8_t> blob;
+        double encode = Measure([&]()
+        {
+            blob.clear();
+
+            BlobWriter writer(Append, &blob, settings);
+            for (size_t i = 0; i < permutations.keys.size(); i++)
+                writer.AddPermutation(permutations.keys[i], permutations.binaries[i].data(), permutations.binaries[i].size());
+
+            writer.Finish();
+
+            return blob.size();
+        });
+
+        // Random access: every permutation is decoded on its own
+        AlignedBlob aligned(blob);
+        std::vector<uint8_t> binary;
+        double decode = Measure([&]()
+        {
+            size_t decodedSize = 0;
+            for (const PermutationKey &key : keys)
+            {
+                if (ReadPermutationFromBlob(aligned.data(), aligned.size, key, binary))
+                    decodedSize += binary.size();
+            }
+
+            return decodedSize;
+        });
+
+        const double megabytes = totalSize / (1024.0 * 1024.0);
+        Utils::Printf("  %-16s %12.1f %8.2f %14.1f %14.1f\n", variant.name, blob.size() / 1024.0, (double)totalSize / blob.size(), megabytes / encode, megabytes / decode);
+    }
+
+    Utils::Printf("  dictionary: %.1f KB, trained in %.1f ms\n", dictionary.size() / 1024.0, training * 1000.0);
+
+    return 0;
+}
+
+// The header formatter "DataOutputContext::WriteDataAsText" replaced: one "fprintf" per byte
+static void WriteDataAsTextFprintf(FILE *stream, const void *data, size_t size, uint32_t &lineLength)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        uint8_t value = ((const uint8_t *)data)[i];
+
+        if (lineLength > 128)
+        {
+            fprintf(stream, "\n    ");
+            lineLength = 0;
+        }
+
+        fprintf(stream, "%u,", value);
+
+        if (value < 10)
+            lineLength += 3;
+        else if (value < 100)
+            lineLength += 4;
+        else
+            lineLength += 5;
+    }
+}
+
+static int Text(size_t size)
+{
+    // Shader binaries, as far as the formatter is concerned: bytes of all magnitudes
+    std::mt19937 random(3);
+    std::vector<uint8_t> data(size);
+    for (uint8_t &value : data)
+        value = (uint8_t)random();
+
+    std::filesystem::path file = std::filesystem::temp_directory_path() / "ShaderMakeBench.h";
+    std::string fileName = file.string();
+
+    Utils::Printf(WHITE "Header text output of %.1f MB, written to '%s':\n", size / (1024.0 * 1024.0), fileName.c_str());
+
+    // Header output is written in the caller's thread, as with "writeIfChanged" off and no asynchronous writer
+    Options options;
+    options.writeIfChanged = false;
+
+    Context ctx;
+    ctx.options = &options;
+
+    double fprintfTime = Measure([&]()
+    {
+        FILE *stream = fopen(fileName.c_str(), "w");
+        if (!stream)
+            return (size_t)0;
+
+        uint32_t lineLength = 129;
+        WriteDataAsTextFprintf(stream, data.data(), data.size(), lineLength);
+        fclose(stream);
+
+        return size;
+    });
+
+    auto writeDataAsText = [&]()
+    {
+        DataOutputContext context(&ctx, fileName.c_str(), true);
+
+        return context.IsValid() && context.WriteDataAsText(data.data(), data.size()) ? size : 0;
+    };
+
+    double decimalTime = Measure(writeDataAsText);
+
+    options.headerHex = true;
+    double hexTime = Measure(writeDataAsText);
+
+    std::error_code ec;
+    std::filesystem::remove(file, ec);
+
+    const double megabytes = size / (1024.0 * 1024.0);
+    Utils::Printf("  %-26s %10.1f MB/s\n", "fprintf per byte", megabytes / fprintfTime);
+    Utils::Printf("  %-26s %10.1f MB/s (%.1fx)\n", "WriteDataAsText", megabytes / decimalTime, fprintfTime / decimalTime);
+    Utils::Printf("  %-26s %10.1f MB/s (%.1fx)\n", "WriteDataAsText (hex)", megabytes / hexTime, fprintfTime / hexTime);
+
+    return 0;
+}
+
+// Checksums of entries of one size against copying them, in a working set of "totalSize" bytes
+static void CrcEntries(const std::vector<uint8_t> &data, std::vector<uint8_t> &copy, size_t totalSize, size_t entrySize)
+{
+    const size_t entryNum = totalSize / entrySize;
+
+    double crc = Measure([&]()
+    {
+        uint32_t checksums = 0;
+        for (size_t i = 0; i < entryNum; i++)
+            checksums ^= Crc32c(data.data() + i * entrySize, entrySize);
+
+        return (size_t)checksums;
+    });
+
+    double copying = Measure([&]()
+    {
+        for (size_t i = 0; i < entryNum; i++)
+            memcpy(copy.data() + i * entrySize, data.data() + i * entrySize, entrySize);
+
+        return (size_t)copy[entryNum * entrySize - 1];
+    });
+
+    const double gigabytes = entryNum * entrySize / (1024.0 * 1024.0 * 1024.0);
+    Utils::Printf("  %10zu %12.2f %12.2f %10.0f%%\n", entrySize, gigabytes / crc, gigabytes / copying, 100.0 * crc / copying);
+}
+
+static int Crc(size_t size)
+{
+    std::mt19937 random(4);
+    std::vector<uint8_t> data(size);
+    for (uint8_t &value : data)
+        value = (uint8_t)random();
+
+    std::vector<uint8_t> copy(size, 0);
+
+    const size_t entrySizes[] = { 64, 256, 1024, 4096, 16384, 65536 };
+    const size_t cachedSize = std::min<size_t>(size, 256 << 10);
+
+    const size_t workingSets[] = { cachedSize, size };
+    for (size_t workingSet : workingSets)
+    {
+        Utils::Printf(WHITE "CRC32C vs memcpy, %.2f MB working set:\n", workingSet / (1024.0 * 1024.0));
+        Utils::Printf("  %10s %12s %12s %11s\n", "entry", "crc (GB/s)", "copy (GB/s)", "crc / copy");
+
+        for (size_t entrySize : entrySizes)
+            CrcEntries(data, copy, workingSet, entrySize);
+    }
+
+    // Bulk verification of a whole blob, as after a download
+    std::vector<uint8_t> blob;
+    {
+        BlobWriterSettings settings;
+        settings.deduplicate = false;
+        settings.checksums = true;
+
+        BlobWriter writer(Append, &blob, settings);
+        for (size_t offset = 0, i = 0; offset + 4096 <= size; offset += 4096, i++)
+            writer.AddPermutation("ID=" + std::to_string(i), data.data() + offset, 4096);
+
+        writer.Finish();
+    }
+
+    AlignedBlob aligned(blob);
+    std::vector<uint8_t> blobCopy(blob.size());
+
+    double verification = Measure([&]() { return (size_t)VerifyBlob(aligned.data(), aligned.size); });
+    double copying = Measure([&]()
+    {
+        memcpy(blobCopy.data(), aligned.data(), aligned.size);
+        return (size_t)blobCopy.back();
+    });
+
+    Utils::Printf(WHITE "VerifyBlob, %.2f MB blob of 4 KB permutations: %.2f ms, memcpy %.2f ms (%.0f%%)\n",
+        blob.size() / (1024.0 * 1024.0), verification * 1000.0, copying * 1000.0, 100.0 * verification / copying);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string command = argv[1];
+    uint32_t maxPermutationNum = 16384;
+    uint32_t permutationNum = 256;
+    size_t binarySize = 2048;
+    const char *blobFile = nullptr;
+    size_t size = 0; // 0 = the default of the command
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--max-permutations" && hasValue)
+            maxPermutationNum = (uint32_t)std::max(atoi(argv[++i]), 16);
+        else if (arg == "--permutations" && hasValue)
+            permutationNum = (uint32_t)std::max(atoi(argv[++i]), 1);
+        else if (arg == "--binary-size" && hasValue)
+            binarySize = (size_t)std::max(atoi(argv[++i]), 64);
+        else if (arg == "--blob" && hasValue)
+            blobFile = argv[++i];
+        else if (arg == "--size" && hasValue)
+            size = (size_t)std::max(atoi(argv[++i]), 1) << 20;
+        else
+        {
+            Utils::Printf(RED "ERROR: Unknown argument '%s'!\n", arg.c_str());
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (command == "lookup")
+        return Lookup(maxPermutationNum, binarySize);
+    if (command == "compression")
+        return Compression(permutationNum, binarySize, blobFile);
+    if (command == "text")
+        return Text(size ? size : 16 << 20);
+    if (command == "crc")
+        return Crc(size ? size : 64 << 20);
+
+    Utils::Printf(RED "ERROR: Unknown command '%s'!\n", command.c_str());
+    PrintUsage();
+
+    return 1;
+}
@@ -0,0 +1,566 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#define SHADERMAKE_COLORS
+#include <ShaderMake/ShaderMake.h>
+
+#include <unordered_map>
+
+using namespace ShaderMake;
+
+static void PrintUsage()
+{
+    Utils::Printf(
+        "Usage:\n"
+        "  ShaderMakeBlob stats <blob>... [--keys]\n"
+        "  ShaderMakeBlob filter <blob> -o <output> [options]\n"
+        "  ShaderMakeBlob merge <blob>... -o <output> [options]\n"
+        "  ShaderMakeBlob split <blob> -o <output> --max-size <KB> [options]\n"
+        "Options:\n"
+        "  --include <pattern>  keep permutations with matching keys, '*' and '?' are wildcards (repeatable)\n"
+        "  --exclude <pattern>  drop permutations with matching keys (repeatable)\n"
+        "  --max-size <KB>      split the output into '<output>_<N>' files of at most this size of permutations\n"
+        "  --v1 | --v2          output format, v2 if any input is v2 by default\n"
+        "  --compress           compress v2 permutations (without a dictionary)\n"
+        "  --checksums          store v2 checksums\n"
+        "  --align <bytes>      align v2 payloads\n");
+}
+
+// "*" matches any sequence, "?" any single character
+static bool MatchPattern(const char *pattern, const char *text)
+{
+    const char *star = nullptr;
+    const char *starText = nullptr;
+    while (*text)
+    {
+        if (*pattern == '*')
+        {
+            star = pattern++;
+            starText = text;
+        }
+        else if (*pattern == '?' || *pattern == *text)
+        {
+            pattern++;
+            text++;
+        }
+        else if (star)
+        {
+            pattern = star + 1;
+            text = ++starText;
+        }
+        else
+            return false;
+    }
+
+    while (*pattern == '*')
+        pattern++;
+
+    return *pattern == 0;
+}
+
+static bool WriteToFileCallback(const void *data, size_t size, void *context)
+{
+    return fwrite(data, 1, size, (FILE *)context) == size;
+}
+
+struct InputBlob
+{
+    std::filesystem::path path;
+    MappedFile file;
+    uint32_t version = 0;
+    std::vector<std::string> keys; // "" for the default permutation
+    uint32_t indexSize = 0; // v2 index table
+    PermutationLayout layout; // empty if the blob has no dimension descriptor
+};
+
+static bool OpenInput(const std::filesystem::path &path, InputBlob &input)
+{
+    input.path = path;
+    if (!input.file.Open(path))
+    {
+        Utils::Printf(RED "ERROR: Can't open blob '%s'!\n", Utils::PathToString(path).c_str());
+        return false;
+    }
+
+    input.version = GetBlobVersion(input.file.GetData(), input.file.GetSize());
+    if (input.version == 0)
+    {
+        Utils::Printf(RED "ERROR: '%s' is not a permutation blob!\n", Utils::PathToString(path).c_str());
+        return false;
+    }
+
+    EnumeratePermutationsInBlob(input.file.GetData(), input.file.GetSize(), input.keys);
+    for (std::string &key : input.keys)
+    {
+        if (key == "<default>")
+            key.clear();
+    }
+
+    const ShaderBlobTocEntry *toc = nullptr;
+    uint32_t entryNum = 0;
+    if (input.version == 2 && GetBlobTableOfContents(input.file.GetData(), input.file.GetSize(), &toc, &entryNum))
+    {
+        ShaderBlobFooter footer;
+        memcpy(&footer, input.file.GetData() + input.file.GetSize() - sizeof(footer), sizeof(footer));
+
+        input.indexSize = footer.indexSize;
+        input.layout.Load(input.file.GetData(), input.file.GetSize());
+    }
+
+    return true;
+}
+
+// Index of a permutation in "layout", ~0u if the key doesn't fit it
+static uint32_t GetLayoutIndex(const PermutationLayout &layout, const std::string &key)
+{
+    // "NAME=value" pairs separated by spaces, split in place
+    std::string buffer = key;
+    std::vector<ShaderConstant> constants;
+    for (char *define = strtok(buffer.data(), " "); define; define = strtok(nullptr, " "))
+    {
+        char *value = strchr(define, '=');
+        if (!value)
+            return ~0u;
+
+        *value++ = '\0';
+        constants.push_back({ define, value });
+    }
+
+    return layout.GetIndex(constants.data(), (uint32_t)constants.size());
+}
+
+// Output blob, split into numbered files if it grows over "splitSize". Permutations are streamed to the file,
+// v2 blobs keep only keys and table of contents in memory until they are finished.
+class OutputBlob
+{
+public:
+    OutputBlob(const std::filesystem::path &file, bool isV2, const BlobWriterSettings &settings, uint64_t splitSize)
+        : m_File(file), m_IsV2(isV2), m_Settings(settings), m_SplitSize(splitSize)
+    {}
+
+    ~OutputBlob() { Close(); }
+
+    bool Add(const std::string &key, const void *binary, size_t binarySize, uint32_t index)
+    {
+        uint64_t entrySize = sizeof(ShaderBlobEntry) + key.size() + binarySize;
+        if (m_Stream && m_SplitSize && m_PartSize && m_PartSize + entrySize > m_SplitSize)
+        {
+            if (!Close())
+                return false;
+        }
+
+        if (!m_Stream && !Open())
+            return false;
+
+        bool success = m_Writer ? m_Writer->AddPermutation(key, binary, binarySize, index) : WritePermutation(WriteToFileCallback, m_Stream, key, binary, binarySize);
+        if (!success)
+        {
+            Utils::Printf(RED "ERROR: Can't write blob '%s'!\n", Utils::PathToString(GetPartFile()).c_str());
+            return false;
+        }
+
+        m_PartSize += entrySize;
+        m_PermutationNum++;
+
+        return true;
+    }
+
+    bool Close()
+    {
+        if (!m_Stream)
+            return true;
+
+        // v1 blobs have no trailer
+        bool success = !m_Writer || m_Writer->Finish();
+        m_Writer.reset();
+        success &= fclose(m_Stream) == 0;
+        m_Stream = nullptr;
+
+        if (!success)
+            Utils::Printf(RED "ERROR: Can't write blob '%s'!\n", Utils::PathToString(GetPartFile()).c_str());
+
+        m_PartNum++;
+        m_PartSize = 0;
+
+        return success;
+    }
+
+    uint32_t GetPartNum() const { return m_PartNum; }
+    uint32_t GetPermutationNum() const { return m_PermutationNum; }
+
+private:
+    std::filesystem::path GetPartFile() const
+    {
+        if (!m_SplitSize)
+            return m_File;
+
+        std::filesystem::path partFile = m_File;
+        partFile.replace_filename(m_File.stem().string() + "_" + std::to_string(m_PartNum) + m_File.extension().string());
+
+        return partFile;
+    }
+
+    bool Open()
+    {
+        std::filesystem::path file = GetPartFile();
+        m_Stream = fopen(Utils::PathToString(file).c_str(), "wb");
+        if (!m_Stream)
+        {
+            Utils::Printf(RED "ERROR: Can't open file '%s' for writing!\n", Utils::PathToString(file).c_str());
+            return false;
+        }
+
+        if (m_IsV2)
+            m_Writer = std::make_unique<BlobWriter>(WriteToFileCallback, m_Stream, m_Settings);
+        else if (!WriteFileHeader(WriteToFileCallback, m_Stream))
+            return false;
+
+        return true;
+    }
+
+    std::filesystem::path m_File;
+    bool m_IsV2;
+    BlobWriterSettings m_Settings;
+    uint64_t m_SplitSize;
+    FILE *m_Stream = nullptr;
+    std::unique_ptr<BlobWriter> m_Writer;
+    uint64_t m_PartSize = 0;
+    uint32_t m_PartNum = 0;
+    uint32_t m_PermutationNum = 0;
+};
+
+static int Stats(const std::vector<std::filesystem::path> &blobs, bool listKeys)
+{
+    bool isCorrupted = false;
+    for (const std::filesystem::path &path : blobs)
+    {
+        InputBlob input;
+        if (!OpenInput(path, input))
+            return 1;
+
+        const uint8_t *data = input.file.GetData();
+        size_t size = input.file.GetSize();
+
+        // Sizes of the permutations, resolved in one pass
+        std::vector<PermutationKey> keys(input.keys.begin(), input.keys.end());
+        std::vector<const void *> binaries(keys.size());
+        std::vector<size_t> sizes(keys.size());
+        FindPermutationsInBlob(data, size, keys.data(), (uint32_t)keys.size(), binaries.data(), sizes.data());
+
+        const ShaderBlobTocEntry *toc = nullptr;
+        uint32_t entryNum = 0;
+        ShaderBlobFooter footer = {};
+        if (input.version == 2 && GetBlobTableOfContents(data, size, &toc, &entryNum))
+            memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+
+        // Compressed v2 permutations are not found, their sizes are in the table of contents
+        std::unordered_map<std::string, const ShaderBlobTocEntry *> entries;
+        for (uint32_t i = 0; i < entryNum; i++)
+            entries.emplace(std::string((const char *)data + toc[i].keyOffset, toc[i].keySize), toc + i);
+
+        uint64_t totalSize = 0;
+        uint64_t storedSize = 0;
+        size_t minSize = SIZE_MAX;
+        size_t maxSize = 0;
+        uint32_t compressedNum = 0;
+        std::vector<uint64_t> payloadOffsets;
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            auto entry = entries.find(input.keys[i]);
+            if (entry != entries.end())
+            {
+                sizes[i] = entry->second->dataSize;
+                storedSize += entry->second->storedSize;
+                payloadOffsets.push_back(entry->second->dataOffset);
+                if (entry->second->flags & ShaderBlobFlag_Compressed)
+                    compressedNum++;
+            }
+            else
+                storedSize += sizes[i];
+
+            totalSize += sizes[i];
+            minSize = std::min(minSize, sizes[i]);
+            maxSize = std::max(maxSize, sizes[i]);
+
+        }
+
+        std::sort(payloadOffsets.begin(), payloadOffsets.end());
+        uint32_t sharedNum = (uint32_t)(payloadOffsets.end() - std::unique(payloadOffsets.begin(), payloadOffsets.end()));
+
+        Utils::Printf(WHITE "%s: v%u, %u permutations, %.1f KB\n", Utils::PathToString(path).c_str(), input.version, (uint32_t)keys.size(), double(size) / 1024.0);
+        Utils::Printf(WHITE "  Permutations: %.1f KB, %.1f KB stored (min %zu, avg %llu, max %zu bytes)\n",
+            double(totalSize) / 1024.0, double(storedSize) / 1024.0, keys.empty() ? 0 : minSize, keys.empty() ? 0ull : (unsigned long long)(totalSize / keys.size()), maxSize);
+
+        if (input.version == 2)
+        {
+            Utils::Printf(WHITE "  Compressed: %u, deduplicated: %u, dictionary: %.1f KB\n", compressedNum, sharedNum, double(footer.dictionarySize) / 1024.0);
+
+            if (input.indexSize)
+                Utils::Printf(WHITE "  Index table: %u entries, %s\n", input.indexSize, input.layout.IsEmpty() ? "no dimension descriptor" : (std::to_string(input.layout.GetDimensions().size()) + " dimensions").c_str());
+
+            if (GetBlobChecksums(data, size))
+            {
+                std::vector<std::string> corrupted;
+                VerifyBlob(data, size, &corrupted);
+                for (const std::string &key : corrupted)
+                    Utils::Printf(RED "ERROR: Corrupted permutation '%s'\n", key.c_str());
+
+                Utils::Printf(WHITE "  Checksums: %u permutations corrupted\n", (uint32_t)corrupted.size());
+                isCorrupted |= !corrupted.empty();
+            }
+        }
+
+        if (listKeys)
+        {
+            for (size_t i = 0; i < keys.size(); i++)
+                Utils::Printf(GRAY "  %10zu " WHITE "%s\n", sizes[i], input.keys[i].empty() ? "<default>" : input.keys[i].c_str());
+        }
+    }
+
+    return isCorrupted ? 1 : 0;
+}
+
+static bool IsSelected(const std::string &key, const std::vector<std::string> &includes, const std::vector<std::string> &excludes)
+{
+    auto matches = [&key](const std::string &pattern) { return MatchPattern(pattern.c_str(), key.c_str()); };
+
+    if (!includes.empty() && std::none_of(includes.begin(), includes.end(), matches))
+        return false;
+
+    return std::none_of(excludes.begin(), excludes.end(), matches);
+}
+
+// Filters, merges and splits: inputs are memory mapped, the output is streamed.
+// Permutations present in several inputs are taken from the last one, as with patch blobs.
+// The index table is rebuilt if all inputs share one layout, permutations filtered out are just not found by index.
+static int Repack(const std::vector<std::filesystem::path> &blobs, const std::filesystem::path &output, const std::vector<std::string> &includes,
+    const std::vector<std::string> &excludes, int version, BlobWriterSettings settings, uint64_t splitSize)
+{
+    std::vector<std::unique_ptr<InputBlob>> inputs;
+    for (const std::filesystem::path &path : blobs)
+    {
+        inputs.push_back(std::make_unique<InputBlob>());
+        if (!OpenInput(path, *inputs.back()))
+            return 1;
+
+        if (version == 0 && inputs.back()->version == 2)
+            version = 2;
+    }
+
+    const PermutationLayout &layout = inputs[0]->layout;
+    bool isLayoutShared = std::all_of(inputs.begin(), inputs.end(),
+        [&layout](const std::unique_ptr<InputBlob> &input) { return !input->layout.IsEmpty() && input->layout.GetDimensions() == layout.GetDimensions(); });
+    bool hasIndex = std::any_of(inputs.begin(), inputs.end(), [](const std::unique_ptr<InputBlob> &input) { return input->indexSize != 0; });
+
+    if (version == 2 && isLayoutShared)
+    {
+        settings.indexSize = layout.GetIndexSize();
+        settings.dimensions = layout.GetDimensions();
+    }
+    else if (hasIndex)
+    {
+        if (version != 2)
+            Utils::Printf(YELLOW "WARNING: v1 blobs have no index table, lookups by index are dropped\n");
+        else
+            Utils::Printf(YELLOW "WARNING: The inputs don't share one permutation layout, the index table and lookups by index are dropped\n");
+    }
+
+    // The owner of a key is the last input having it, "EMITTED" once it's written
+    const uint32_t EMITTED = ~0u;
+    std::unordered_map<std::string, uint32_t> keyOwners;
+    for (uint32_t i = 0; i < (uint32_t)inputs.size(); i++)
+    {
+        for (const std::string &key : inputs[i]->keys)
+            keyOwners[key] = i;
+    }
+
+    OutputBlob outputBlob(output, version == 2, settings, splitSize);
+    uint32_t overriddenNum = 0;
+    uint32_t droppedNum = 0;
+    uint32_t duplicateNum = 0;
+    std::vector<uint8_t> decompressed;
+    for (uint32_t i = 0; i < (uint32_t)inputs.size(); i++)
+    {
+        const InputBlob &input = *inputs[i];
+
+        // v1 blobs may hold a key more than once, lookups find the first one
+        std::vector<PermutationKey> keys;
+        for (const std::string &key : input.keys)
+        {
+            uint32_t &owner = keyOwners[key];
+            if (owner == EMITTED)
+                duplicateNum++;
+            else if (owner != i)
+                overriddenNum++;
+            else if (!IsSelected(key, includes, excludes))
+                droppedNum++;
+            else
+                keys.emplace_back(key);
+
+            if (owner == i)
+                owner = EMITTED;
+        }
+
+        std::vector<const void *> binaries(keys.size());
+        std::vector<size_t> sizes(keys.size());
+        FindPermutationsInBlob(input.file.GetData(), input.file.GetSize(), keys.data(), (uint32_t)keys.size(), binaries.data(), sizes.data());
+
+        for (size_t j = 0; j < keys.size(); j++)
+        {
+            // Compressed v2 permutations are decompressed one at a time
+            if (!binaries[j])
+            {
+                if (!ReadPermutationFromBlob(input.file.GetData(), input.file.GetSize(), keys[j], decompressed))
+                {
+                    Utils::Printf(RED "ERROR: Can't read permutation '%s' from '%s'!\n", keys[j].GetString().c_str(), Utils::PathToString(input.path).c_str());
+                    return 1;
+                }
+
+                binaries[j] = decompressed.data();
+                sizes[j] = decompressed.size();
+            }
+
+            uint32_t index = settings.indexSize ? GetLayoutIndex(layout, keys[j].GetString()) : ~0u;
+            if (!outputBlob.Add(keys[j].GetString(), binaries[j], sizes[j], index))
+                return 1;
+        }
+    }
+
+    if (!outputBlob.Close())
+        return 1;
+
+    Utils::Printf(WHITE "%u permutations written to %u file(s), %u filtered out, %u overridden by later inputs, %u duplicates skipped\n",
+        outputBlob.GetPermutationNum(), outputBlob.GetPartNum(), droppedNum, overriddenNum, duplicateNum);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string command = argv[1];
+    std::vector<std::filesystem::path> blobs;
+    std::filesystem::path output;
+    std::vector<std::string> includes;
+    std::vector<std::string> excludes;
+    BlobWriterSettings settings;
+    uint64_t splitSize = 0;
+    int version = 0;
+    bool listKeys = false;
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-o" && hasValue)
+            output = argv[++i];
+        else if (arg == "--include" && hasValue)
+            includes.push_back(argv[++i]);
+        else if (arg == "--exclude" && hasValue)
+            excludes.push_back(argv[++i]);
+        else if (arg == "--max-size" && hasValue)
+            splitSize = strtoull(argv[++i], nullptr, 10) << 10;
+        else if (arg == "--v1")
+            version = 1;
+        else if (arg == "--v2")
+            version = 2;
+        else if (arg == "--compress")
+            settings.compress = true;
+        else if (arg == "--checksums")
+            settings.checksums = true;
+        else if (arg == "--align" && hasValue)
+            settings.alignment = (uint32_t)std::max(atoi(argv[++i]), 0);
+        else if (arg == "--keys")
+            listKeys = true;
+        else if (arg[0] == '-')
+        {
+            Utils::Printf(RED "ERROR: Unknown argument '%s'!\n", arg.c_str());
+            PrintUsage();
+            return 1;
+        }
+        else
+            blobs.push_back(arg);
+    }
+
+    if (blobs.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (settings.alignment & (settings.alignment - 1))
+    {
+        Utils::Printf(RED "ERROR: Alignment must be a power of 2!\n");
+        return 1;
+    }
+
+    // v2 options imply v2
+    if (version == 1 && (settings.compress || settings.checksums || settings.alignment))
+    {
+        Utils::Printf(RED "ERROR: --compress, --checksums and --align need v2 output!\n");
+        return 1;
+    }
+    else if (settings.compress || settings.checksums || settings.alignment)
+        version = 2;
+
+    if (command == "stats")
+        return Stats(blobs, listKeys);
+
+    if (command != "filter" && command != "merge" && command != "split")
+    {
+        Utils::Printf(RED "ERROR: Unknown command '%s'!\n", command.c_str());
+        PrintUsage();
+        return 1;
+    }
+
+    if (output.empty())
+    {
+        Utils::Printf(RED "ERROR: No output blob, use -o!\n");
+        return 1;
+    }
+
+    if ((command != "merge" && blobs.size() > 1) || (command == "split" && !splitSize))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // Outputs are written while the inputs are mapped
+    for (const std::filesystem::path &blob : blobs)
+    {
+        std::error_code ec;
+        if (std::filesystem::equivalent(blob, output, ec))
+        {
+            Utils::Printf(RED "ERROR: The output overwrites input '%s'!\n", Utils::PathToString(blob).c_str());
+            return 1;
+        }
+    }
+
+    return Repack(blobs, output, includes, excludes, version, settings, splitSize);
+}
@@ -0,0 +1,153 @@
+/*
+Copyright (c) 2014-2025, NVIDIA CORPORATION. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#define SHADERMAKE_COLORS
+#include <ShaderMake/ShaderMake.h>
+
+#include <thread>
+
+using namespace ShaderMake;
+
+static void PrintUsage()
+{
+    Utils::Printf(
+        "Usage:\n"
+        "  ShaderMakeCache <cache directory> stats [--top <N>]\n"
+        "  ShaderMakeCache <cache directory> verify [--fix] [-j <threads>]\n"
+        "  ShaderMakeCache <cache directory> gc [--max-size <MB>] [--max-age <days>] [-j <threads>]\n");
+}
+
+static int Stats(CompileCache &cache, uint32_t topNum)
+{
+    CacheStats stats;
+    if (!cache.LoadStats(stats))
+        Utils::Printf(YELLOW "WARNING: No statistics recorded in '%s' yet\n", Utils::PathToString(cache.GetDirectory()).c_str());
+
+    uint64_t lookups = stats.hits + stats.misses;
+    double hitRate = lookups ? 100.0 * double(stats.hits) / double(lookups) : 0.0;
+
+    Utils::Printf(WHITE "Lookups:      %llu\n", (unsigned long long)lookups);
+    Utils::Printf(WHITE "Hits:         %llu (%.1f%%)\n", (unsigned long long)stats.hits, hitRate);
+    Utils::Printf(WHITE "Misses:       %llu (%.1f%%)\n", (unsigned long long)stats.misses, lookups ? 100.0 - hitRate : 0.0);
+    Utils::Printf(WHITE "Bytes saved:  %.1f MB\n", double(stats.bytesSaved) / (1 << 20));
+    Utils::Printf(WHITE "Bytes stored: %.1f MB\n", double(stats.bytesStored) / (1 << 20));
+    if (stats.size)
+        Utils::Printf(WHITE "In use:       %.1f MB\n", double(stats.size) / (1 << 20));
+
+    std::vector<std::pair<std::string, uint64_t>> missedShaders(stats.missedShaders.begin(), stats.missedShaders.end());
+    std::sort(missedShaders.begin(), missedShaders.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+    if (missedShaders.size() > topNum)
+        missedShaders.resize(topNum);
+
+    if (!missedShaders.empty())
+    {
+        Utils::Printf(WHITE "Top missed shaders:\n");
+        for (const auto &[shader, count] : missedShaders)
+            Utils::Printf(GRAY "  %8llu " WHITE "%s\n", (unsigned long long)count, shader.c_str());
+    }
+
+    return 0;
+}
+
+static int Verify(CompileCache &cache, uint32_t threadsNum, bool fix)
+{
+    std::vector<std::filesystem::path> corrupted;
+    uint32_t entriesNum = cache.Verify(threadsNum, fix, corrupted);
+
+    for (const std::filesystem::path &entry : corrupted)
+        Utils::Printf(RED "ERROR: Corrupted entry '%s'%s\n", Utils::PathToString(entry).c_str(), fix ? " (removed)" : "");
+
+    Utils::Printf(WHITE "%u entries verified, %u corrupted\n", entriesNum, (uint32_t)corrupted.size());
+
+    return (corrupted.empty() || fix) ? 0 : 1;
+}
+
+static int Collect(CompileCache &cache, uint32_t threadsNum, uint64_t maxSize, uint64_t maxAge)
+{
+    uint64_t remainingSize = 0;
+    uint32_t evictedNum = cache.Collect(maxSize, maxAge, threadsNum, remainingSize);
+
+    Utils::Printf(WHITE "%u entries evicted, %.1f MB in use\n", evictedNum, double(remainingSize) / (1 << 20));
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::filesystem::path directory = argv[1];
+    std::string command = argv[2];
+
+    if (!std::filesystem::is_directory(directory))
+    {
+        Utils::Printf(RED "ERROR: Cache directory '%s' doesn't exist!\n", argv[1]);
+        return 1;
+    }
+
+    uint32_t threadsNum = std::max(std::thread::hardware_concurrency(), 1u);
+    uint32_t topNum = 10;
+    uint64_t maxSize = UINT64_MAX;
+    uint64_t maxAge = 0;
+    bool fix = false;
+
+    for (int i = 3; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--fix")
+            fix = true;
+        else if (arg == "-j" && hasValue)
+            threadsNum = std::max(atoi(argv[++i]), 1);
+        else if (arg == "--top" && hasValue)
+            topNum = (uint32_t)std::max(atoi(argv[++i]), 0);
+        else if (arg == "--max-size" && hasValue)
+            maxSize = strtoull(argv[++i], nullptr, 10) << 20;
+        else if (arg == "--max-age" && hasValue)
+            maxAge = strtoull(argv[++i], nullptr, 10) * 24 * 3600;
+        else
+        {
+            Utils::Printf(RED "ERROR: Unknown argument '%s'!\n", arg.c_str());
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    CompileCache cache(directory, maxSize);
+
+    if (command == "stats")
+        return Stats(cache, topNum);
+    else if (command == "verify")
+        return Verify(cache, threadsNum, fix);
+    else if (command == "gc")
+        return Collect(cache, threadsNum, maxSize, maxAge);
+
+    Utils::Printf(RED "ERROR: Unknown command '%s'!\n", command.c_str());
+    PrintUsage();
+
+    return 1;
+}
@@ -16,4 +16,5 @@ INTOUTPUT_DIR = "%{wks.location}/bin-int/%{prj.name}"
 
 
 include "Sample/Sample.lua"
+include "Tools/Tools.lua"
 include "ShaderMake/ShaderMake.lua"